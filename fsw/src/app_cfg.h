@@ -40,9 +40,13 @@
 ** Versions:
 **
 ** 1.0 - Initial release
+** 1.1 - Add optional LED output readback using a sense input
+** 1.2 - Add multiplexed LED matrix mode
+** 1.3 - Add hardware PWM/GPCLK LED output
+** 1.4 - Event driven child task with CPU time and wakeup telemetry
 */
 #define  RPI_LED_MAJOR_VER   1
-#define  RPI_LED_MINOR_VER   0
+#define  RPI_LED_MINOR_VER   4
 
 /******************************************************************************
 ** Init File declarations create:
@@ -80,6 +84,19 @@
 
 #define CFG_CTRL_OUT_PIN     CTRL_OUT_PIN
 
+#define CFG_CTRL_SENSE_CHIP        CTRL_SENSE_CHIP
+#define CFG_CTRL_SENSE_PIN         CTRL_SENSE_PIN
+#define CFG_CTRL_SENSE_TIMEOUT_MS  CTRL_SENSE_TIMEOUT_MS
+
+#define CFG_BCM_REGS_SIM             BCM_REGS_SIM
+#define CFG_BCM_PERIPH_BASE          BCM_PERIPH_BASE
+#define CFG_PWM_OSC_HZ               PWM_OSC_HZ
+#define CFG_MATRIX_ROW_PINS          MATRIX_ROW_PINS
+#define CFG_MATRIX_COL_PINS          MATRIX_COL_PINS
+#define CFG_MATRIX_ROW_ACTIVE_HIGH   MATRIX_ROW_ACTIVE_HIGH
+#define CFG_MATRIX_COL_ACTIVE_HIGH   MATRIX_COL_ACTIVE_HIGH
+#define CFG_MATRIX_REFRESH_HZ        MATRIX_REFRESH_HZ
+
 #define CFG_CTRL_ON_CMD_TOPICID     RPI_LED_CTRL_ON_CMD_TOPICID
 #define CFG_CTRL_OFF_CMD_TOPICID    RPI_LED_CTRL_OFF_CMD_TOPICID
 #define CFG_LED_ON_CMD_ID           RPI_LED_ON_CMD_ID
@@ -98,6 +115,17 @@
    XX(CHILD_STACK_SIZE,uint32) \
    XX(CHILD_PRIORITY,uint32) \
    XX(CTRL_OUT_PIN,uint32) \
+   XX(CTRL_SENSE_CHIP,char*) \
+   XX(CTRL_SENSE_PIN,uint32) \
+   XX(CTRL_SENSE_TIMEOUT_MS,uint32) \
+   XX(BCM_REGS_SIM,uint32) \
+   XX(BCM_PERIPH_BASE,char*) \
+   XX(PWM_OSC_HZ,uint32) \
+   XX(MATRIX_ROW_PINS,char*) \
+   XX(MATRIX_COL_PINS,char*) \
+   XX(MATRIX_ROW_ACTIVE_HIGH,uint32) \
+   XX(MATRIX_COL_ACTIVE_HIGH,uint32) \
+   XX(MATRIX_REFRESH_HZ,uint32) \
 
 DECLARE_ENUM(Config,APP_CONFIG)
 
@@ -110,5 +138,9 @@ DECLARE_ENUM(Config,APP_CONFIG)
 */
 #define RPI_LED_BASE_EID    (APP_C_FW_APP_BASE_EID +  0)
 #define LED_CTRL_BASE_EID   (APP_C_FW_APP_BASE_EID + 20)
+#define LED_SENSE_BASE_EID  (APP_C_FW_APP_BASE_EID + 40)
+#define LED_MATRIX_BASE_EID (APP_C_FW_APP_BASE_EID + 60)
+#define BCM_REGS_BASE_EID   (APP_C_FW_APP_BASE_EID + 80)
+#define LED_PWM_BASE_EID    (APP_C_FW_APP_BASE_EID + 90)
 
 #endif /* _app_cfg_ */
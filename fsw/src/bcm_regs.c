@@ -0,0 +1,173 @@
+/*
+**  Copyright 2022 bitValence, Inc.
+**  All Rights Reserved.
+**
+**  This program is free software; you can modify and/or redistribute it
+**  under the terms of the GNU Affero General Public License
+**  as published by the Free Software Foundation; version 3 with
+**  attribution addendums as found in the LICENSE.txt
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Affero General Public License for more details.
+**
+**  Purpose:
+**    Implement the BCM peripheral register file class methods
+**
+**  Notes:
+**    1. /dev/gpiomem exposes only the GPIO block and doesn't require
+**       elevated privileges.
+**    2. Simulated blocks are plain memory so status bits such as the
+**       clock manager's BUSY flag never assert.
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "app_cfg.h"
+#include "bcm_regs.h"
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static volatile uint32 *MapBlock(const char *Device, off_t Offset);
+
+
+/******************************************************************************
+** Function: BCM_REGS_Constructor
+**
+*/
+void BCM_REGS_Constructor(BCM_REGS_Class_t *BcmRegs, bool Simulate, uint32 PeriphBase)
+{
+
+   memset(BcmRegs, 0, sizeof(BCM_REGS_Class_t));
+   BcmRegs->Simulate   = Simulate;
+   BcmRegs->PeriphBase = PeriphBase;
+
+} /* End BCM_REGS_Constructor() */
+
+
+/******************************************************************************
+** Function: BCM_REGS_MapGpio
+**
+*/
+bool BCM_REGS_MapGpio(BCM_REGS_Class_t *BcmRegs)
+{
+
+   if (BcmRegs->GpioMapped)
+   {
+      return true;
+   }
+
+   if (BcmRegs->Simulate)
+   {
+      BcmRegs->Gpio = BcmRegs->SimGpio;
+      BcmRegs->GpioMapped = true;
+      CFE_EVS_SendEvent(BCM_REGS_MAP_EID, CFE_EVS_EventType_INFORMATION,
+                        "Using simulated GPIO register block");
+      return true;
+   }
+
+   BcmRegs->Gpio = MapBlock(BCM_REGS_GPIO_DEV, 0);
+   BcmRegs->GpioMapped = (BcmRegs->Gpio != NULL);
+
+   return BcmRegs->GpioMapped;
+
+} /* End BCM_REGS_MapGpio() */
+
+
+/******************************************************************************
+** Function: BCM_REGS_MapPeriph
+**
+*/
+bool BCM_REGS_MapPeriph(BCM_REGS_Class_t *BcmRegs)
+{
+
+   if (BcmRegs->PeriphMapped)
+   {
+      return true;
+   }
+
+   if (BcmRegs->Simulate)
+   {
+      BcmRegs->Clk = BcmRegs->SimClk;
+      BcmRegs->Pwm = BcmRegs->SimPwm;
+      BcmRegs->PeriphMapped = true;
+      CFE_EVS_SendEvent(BCM_REGS_MAP_EID, CFE_EVS_EventType_INFORMATION,
+                        "Using simulated clock manager and PWM register blocks");
+      return true;
+   }
+
+   if (BcmRegs->Clk == NULL)
+   {
+      BcmRegs->Clk = MapBlock(BCM_REGS_MEM_DEV, BcmRegs->PeriphBase + BCM_REGS_CLK_OFFSET);
+   }
+   if (BcmRegs->Pwm == NULL)
+   {
+      BcmRegs->Pwm = MapBlock(BCM_REGS_MEM_DEV, BcmRegs->PeriphBase + BCM_REGS_PWM_OFFSET);
+   }
+   BcmRegs->PeriphMapped = (BcmRegs->Clk != NULL && BcmRegs->Pwm != NULL);
+
+   return BcmRegs->PeriphMapped;
+
+} /* End BCM_REGS_MapPeriph() */
+
+
+/******************************************************************************
+** Function: BCM_REGS_SetPinFunc
+**
+** Each GPFSELn register holds 3-bit function fields for 10 pins.
+*/
+void BCM_REGS_SetPinFunc(BCM_REGS_Class_t *BcmRegs, uint8 Pin, uint8 Func)
+{
+
+   volatile uint32 *FselReg = &BcmRegs->Gpio[BCM_REGS_GPFSEL0 + Pin/10];
+   uint32 Shift = (Pin % 10) * 3;
+
+   *FselReg = (*FselReg & ~(7u << Shift)) | ((uint32)(Func & 7) << Shift);
+
+} /* End BCM_REGS_SetPinFunc() */
+
+
+/******************************************************************************
+** Function: MapBlock
+**
+** Returns NULL and sends an error event if the mapping fails.
+*/
+static volatile uint32 *MapBlock(const char *Device, off_t Offset)
+{
+
+   int   Fd;
+   void *Block;
+
+   Fd = open(Device, O_RDWR | O_SYNC | O_CLOEXEC);
+   if (Fd < 0)
+   {
+      CFE_EVS_SendEvent(BCM_REGS_MAP_EID, CFE_EVS_EventType_ERROR,
+                        "Open %s failed: %s", Device, strerror(errno));
+      return NULL;
+   }
+
+   Block = mmap(NULL, BCM_REGS_BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, Fd, Offset);
+   close(Fd);
+
+   if (Block == MAP_FAILED)
+   {
+      CFE_EVS_SendEvent(BCM_REGS_MAP_EID, CFE_EVS_EventType_ERROR,
+                        "Map %s at 0x%08lX failed: %s", Device, (unsigned long)Offset, strerror(errno));
+      return NULL;
+   }
+
+   return (volatile uint32 *)Block;
+
+} /* End MapBlock() */
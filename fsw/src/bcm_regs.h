@@ -0,0 +1,171 @@
+/*
+**  Copyright 2022 bitValence, Inc.
+**  All Rights Reserved.
+**
+**  This program is free software; you can modify and/or redistribute it
+**  under the terms of the GNU Affero General Public License
+**  as published by the Free Software Foundation; version 3 with
+**  attribution addendums as found in the LICENSE.txt
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Affero General Public License for more details.
+**
+**  Purpose:
+**    Define BCM peripheral register file class
+**
+**  Notes:
+**    1. Provides direct register access for drivers that need more than
+**       rpi_iolib's single pin functions, e.g. writing a multi-pin mask
+**       with one GPSET0/GPCLR0 write.
+**    2. When Simulate is true the register blocks are in-memory arrays so
+**       drivers can be exercised and benchmarked on any host.
+**    3. Register indices are 32-bit word offsets from the block base.
+**    4. The clock manager and PWM blocks are only reachable through
+**       /dev/mem which requires elevated privileges and the SoC's
+**       peripheral base address (0x3F000000 for BCM2836/7, 0xFE000000
+**       for BCM2711).
+**
+*/
+
+#ifndef _bcm_regs_
+#define _bcm_regs_
+
+/*
+** Includes
+*/
+#include "app_cfg.h"
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define BCM_REGS_GPIO_DEV    "/dev/gpiomem"
+#define BCM_REGS_MEM_DEV     "/dev/mem"
+#define BCM_REGS_BLOCK_SIZE  4096
+#define BCM_REGS_BLOCK_WORDS (BCM_REGS_BLOCK_SIZE/sizeof(uint32))
+
+/*
+** GPIO register word offsets
+*/
+#define BCM_REGS_GPFSEL0   0
+#define BCM_REGS_GPSET0    7
+#define BCM_REGS_GPCLR0   10
+#define BCM_REGS_GPLEV0   13
+
+/*
+** GPFSELn function select values
+*/
+#define BCM_REGS_FSEL_INPUT   0
+#define BCM_REGS_FSEL_OUTPUT  1
+#define BCM_REGS_FSEL_ALT0    4
+#define BCM_REGS_FSEL_ALT5    2
+
+/*
+** Clock manager block offset from the peripheral base and register word
+** offsets. Every write must include the password.
+*/
+#define BCM_REGS_CLK_OFFSET   0x101000
+
+#define BCM_REGS_CM_GP0CTL   (0x70/4)
+#define BCM_REGS_CM_GP0DIV   (0x74/4)
+#define BCM_REGS_CM_PWMCTL   (0xA0/4)
+#define BCM_REGS_CM_PWMDIV   (0xA4/4)
+#define BCM_REGS_CM_GP_STRIDE   2      /* Words between GPCLKn register pairs */
+
+#define BCM_REGS_CM_PASSWD      0x5A000000
+#define BCM_REGS_CM_PASSWD_MASK 0xFF000000
+#define BCM_REGS_CM_SRC_OSC     1
+#define BCM_REGS_CM_ENAB        (1u << 4)
+#define BCM_REGS_CM_BUSY        (1u << 7)
+#define BCM_REGS_CM_MASH_SHIFT  9
+#define BCM_REGS_CM_DIVI_SHIFT  12
+#define BCM_REGS_CM_DIVF_MASK   0xFFF
+#define BCM_REGS_CM_DIV_MASK    0xFFFFFF   /* 12.12 fixed point DIVI.DIVF */
+
+/*
+** PWM block offset from the peripheral base and register word offsets.
+** Channel 2 control bits are channel 1's shifted by BCM_REGS_PWM_CTL_CHAN_SHIFT
+** and its RNG/DAT registers are BCM_REGS_PWM_CHAN_STRIDE words after channel 1's.
+*/
+#define BCM_REGS_PWM_OFFSET   0x20C000
+
+#define BCM_REGS_PWM_CTL     0
+#define BCM_REGS_PWM_STA     1
+#define BCM_REGS_PWM_RNG1    4
+#define BCM_REGS_PWM_DAT1    5
+#define BCM_REGS_PWM_CHAN_STRIDE  4
+
+#define BCM_REGS_PWM_CTL_PWEN        (1u << 0)
+#define BCM_REGS_PWM_CTL_MSEN        (1u << 7)
+#define BCM_REGS_PWM_CTL_CHAN_MASK   0xFF
+#define BCM_REGS_PWM_CTL_CHAN_SHIFT  8
+
+#define BCM_REGS_BANK0_PINS  32  /* Pins addressable with a single GPSET0/GPCLR0 write */
+
+/*
+** Event Message IDs
+*/
+#define BCM_REGS_MAP_EID  (BCM_REGS_BASE_EID + 0)
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+/******************************************************************************
+** BCM_REGS_Class
+*/
+typedef struct
+{
+   bool    Simulate;
+   uint32  PeriphBase;
+   bool    GpioMapped;
+   bool    PeriphMapped;
+   volatile uint32 *Gpio;
+   volatile uint32 *Clk;
+   volatile uint32 *Pwm;
+
+   uint32  SimGpio[BCM_REGS_BLOCK_WORDS];
+   uint32  SimClk[BCM_REGS_BLOCK_WORDS];
+   uint32  SimPwm[BCM_REGS_BLOCK_WORDS];
+
+} BCM_REGS_Class_t;
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+/******************************************************************************
+** Function: BCM_REGS_Constructor
+**
+** Notes:
+**   1. Blocks are not mapped until a driver requests them.
+*/
+void BCM_REGS_Constructor(BCM_REGS_Class_t *BcmRegs, bool Simulate, uint32 PeriphBase);
+
+/******************************************************************************
+** Function: BCM_REGS_MapGpio
+**
+** Map the GPIO register block if it isn't already mapped. Returns false
+** and sends an error event if the mapping fails.
+*/
+bool BCM_REGS_MapGpio(BCM_REGS_Class_t *BcmRegs);
+
+/******************************************************************************
+** Function: BCM_REGS_MapPeriph
+**
+** Map the clock manager and PWM register blocks if they aren't already
+** mapped. Returns false and sends an error event if the mapping fails.
+*/
+bool BCM_REGS_MapPeriph(BCM_REGS_Class_t *BcmRegs);
+
+/******************************************************************************
+** Function: BCM_REGS_SetPinFunc
+**
+** Notes:
+**   1. The GPIO block must be mapped
+*/
+void BCM_REGS_SetPinFunc(BCM_REGS_Class_t *BcmRegs, uint8 Pin, uint8 Func);
+
+#endif /* _bcm_regs_ */
@@ -0,0 +1,43 @@
+/*
+**  Copyright 2022 bitValence, Inc.
+**  All Rights Reserved.
+**
+**  This program is free software; you can modify and/or redistribute it
+**  under the terms of the GNU Affero General Public License
+**  as published by the Free Software Foundation; version 3 with
+**  attribution addendums as found in the LICENSE.txt
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Affero General Public License for more details.
+**
+**  Purpose:
+**    Implement clock utility functions shared by the LED classes
+**
+**  Notes:
+**    None
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include "led_clock.h"
+
+
+/******************************************************************************
+** Function: LED_CLOCK_Ns
+**
+*/
+uint64 LED_CLOCK_Ns(clockid_t ClockId)
+{
+
+   struct timespec Now;
+
+   clock_gettime(ClockId, &Now);
+
+   return (uint64)Now.tv_sec * LED_CLOCK_NSEC_PER_SEC + Now.tv_nsec;
+
+} /* End LED_CLOCK_Ns() */
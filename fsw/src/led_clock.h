@@ -0,0 +1,53 @@
+/*
+**  Copyright 2022 bitValence, Inc.
+**  All Rights Reserved.
+**
+**  This program is free software; you can modify and/or redistribute it
+**  under the terms of the GNU Affero General Public License
+**  as published by the Free Software Foundation; version 3 with
+**  attribution addendums as found in the LICENSE.txt
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Affero General Public License for more details.
+**
+**  Purpose:
+**    Define clock utility functions shared by the LED classes
+**
+**  Notes:
+**    1. Times are 64-bit nanosecond counts so they can be compared and
+**       subtracted directly, including on 32-bit targets where time_t is
+**       32 bits.
+**
+*/
+
+#ifndef _led_clock_
+#define _led_clock_
+
+/*
+** Includes
+*/
+#include <time.h>
+#include "app_cfg.h"
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define LED_CLOCK_NSEC_PER_SEC   1000000000ULL
+#define LED_CLOCK_NSEC_PER_MSEC  1000000ULL
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+/******************************************************************************
+** Function: LED_CLOCK_Ns
+**
+** Return the time of ClockId in nanoseconds, e.g. CLOCK_MONOTONIC or
+** CLOCK_THREAD_CPUTIME_ID.
+*/
+uint64 LED_CLOCK_Ns(clockid_t ClockId);
+
+#endif /* _led_clock_ */
@@ -19,6 +19,11 @@
 **    1. A GPIO mapping failure is unrecoverable so the child task
 **       exits. A mapping failure is most likely due to an incorrect
 **       configuration in RPI_IOLIB's config.h file.  
+**    2. When a sense pin is configured the child task monitors it so
+**       the commanded LED state can be verified. See led_sense.h.
+**    3. In matrix mode the child task wakes at each row deadline to scan
+**       the next row. See led_matrix.h.
+**    4. An on/off command stops an active PWM output.
 **
 */
 
@@ -26,13 +31,28 @@
 ** Include Files:
 */
 
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include "app_cfg.h"
+#include "led_clock.h"
 #include "led_ctrl.h"
+#include "rpi_led_eds_cc.h"
 #include "gpio.h"
 
 static LED_CTRL_Class_t  *LedCtrl = NULL;
 
+static void   ArmTimer(uint64 DeadlineNs);
+static void   DriveOutput(bool LedOn);
+static void   ExpectSense(bool LedOn);
+static void   InitEventLoop(void);
+static uint64 NextDeadline(void);
+static void   WakeChild(void);
+
 /******************************************************************************
 ** Function: LED_CTRL_Constructor
 */
@@ -40,7 +60,22 @@ void LED_CTRL_Constructor(LED_CTRL_Class_t *LedCtrlPtr, INITBL_Class_t *IniTbl)
 {
    LedCtrl = LedCtrlPtr;
    memset(LedCtrl, 0, sizeof(LED_CTRL_Class_t));
-   LedCtrl->OutPin = INITBL_GetIntConfig(IniTbl, CFG_CTRL_OUT_PIN);
+   LedCtrl->OutPin  = INITBL_GetIntConfig(IniTbl, CFG_CTRL_OUT_PIN);
+   LedCtrl->EpollFd = -1;
+   LedCtrl->WakeFd  = -1;
+   LedCtrl->TimerFd = -1;
+
+   LED_SENSE_Constructor(&LedCtrl->Sense, INITBL_GetStrConfig(IniTbl, CFG_CTRL_SENSE_CHIP),
+                         INITBL_GetIntConfig(IniTbl, CFG_CTRL_SENSE_PIN),
+                         INITBL_GetIntConfig(IniTbl, CFG_CTRL_SENSE_TIMEOUT_MS));
+
+   BCM_REGS_Constructor(&LedCtrl->BcmRegs, (INITBL_GetIntConfig(IniTbl, CFG_BCM_REGS_SIM) != 0),
+                        strtoul(INITBL_GetStrConfig(IniTbl, CFG_BCM_PERIPH_BASE), NULL, 0));
+   LED_MATRIX_Constructor(&LedCtrl->Matrix, IniTbl, &LedCtrl->BcmRegs);
+   LED_PWM_Constructor(&LedCtrl->Pwm, &LedCtrl->BcmRegs, LedCtrl->OutPin,
+                       INITBL_GetIntConfig(IniTbl, CFG_PWM_OSC_HZ));
+
+   InitEventLoop();
 
    if (gpio_map() < 0) // map peripherals
    {
@@ -62,6 +97,8 @@ bool LED_CTRL_TurnOnCmd(void *DataObjPtr, const CFE_MSG_Message_t *MsgPtr)
 {
    if (LedCtrl->IsMapped)
    {
+      LED_PWM_Stop(&LedCtrl->Pwm);
+      ExpectSense(true);
       gpio_set(LedCtrl->OutPin);
       LedCtrl->LedOn = true;
       CFE_EVS_SendEvent(LED_CTRL_CHILD_TASK_EID, CFE_EVS_EventType_INFORMATION, 
@@ -77,6 +114,8 @@ bool LED_CTRL_TurnOffCmd(void *DataObjPtr, const CFE_MSG_Message_t *MsgPtr)
 {
    if (LedCtrl->IsMapped)
    {
+      LED_PWM_Stop(&LedCtrl->Pwm);
+      ExpectSense(false);
       gpio_clr(LedCtrl->OutPin);
       LedCtrl->LedOn = false;
       CFE_EVS_SendEvent(LED_CTRL_CHILD_TASK_EID, CFE_EVS_EventType_INFORMATION, 
@@ -85,12 +124,112 @@ bool LED_CTRL_TurnOffCmd(void *DataObjPtr, const CFE_MSG_Message_t *MsgPtr)
    return true;
 }
 
+/******************************************************************************
+** Function: LED_CTRL_SetPwmCmd
+*/
+bool LED_CTRL_SetPwmCmd(void *DataObjPtr, const CFE_MSG_Message_t *MsgPtr)
+{
+   const RPI_LED_SetPwm_CmdPayload_t *Cmd = CMDMGR_PAYLOAD_PTR(MsgPtr, RPI_LED_SetPwm_t);
+
+   LED_SENSE_Suspend(&LedCtrl->Sense);
+   if (LED_PWM_Start(&LedCtrl->Pwm, Cmd->FreqHz, Cmd->DutyPermille))
+   {
+      return true;
+   }
+
+   /* Return to the commanded level unless a previous PWM output is still running */
+   if (!LedCtrl->Pwm.Active)
+   {
+      ExpectSense(LedCtrl->LedOn);
+      DriveOutput(LedCtrl->LedOn);
+   }
+   return false;
+}
+
+/******************************************************************************
+** Function: LED_CTRL_StopPwmCmd
+*/
+bool LED_CTRL_StopPwmCmd(void *DataObjPtr, const CFE_MSG_Message_t *MsgPtr)
+{
+   if (!LedCtrl->Pwm.Active)
+   {
+      CFE_EVS_SendEvent(LED_CTRL_PWM_EID, CFE_EVS_EventType_ERROR,
+                        "Stop PWM rejected, GPIO pin %d PWM output is not active", LedCtrl->OutPin);
+      return false;
+   }
+
+   LED_PWM_Stop(&LedCtrl->Pwm);
+   ExpectSense(LedCtrl->LedOn);
+   DriveOutput(LedCtrl->LedOn);
+   CFE_EVS_SendEvent(LED_CTRL_PWM_EID, CFE_EVS_EventType_INFORMATION,
+                     "GPIO pin %d returned to %s", LedCtrl->OutPin, LedCtrl->LedOn ? "ON" : "OFF");
+
+   return true;
+}
+
 /******************************************************************************
 ** Function: LED_CTRL_ChildTask
 */
 bool LED_CTRL_ChildTask(CHILDMGR_Class_t* ChildMgr)
 {
-   return false; // No need for continuous looping as commands handle on/off
+   struct epoll_event Events[LED_CTRL_EPOLL_EVENTS];
+   uint64 Count, NowNs;
+   int    EventCnt, i;
+
+   if (LedCtrl->EpollFd < 0)
+   {
+      return false;
+   }
+
+   ArmTimer(NextDeadline());
+
+   EventCnt = epoll_wait(LedCtrl->EpollFd, Events, LED_CTRL_EPOLL_EVENTS, -1);
+   if (EventCnt < 0)
+   {
+      if (errno == EINTR)
+      {
+         return true;
+      }
+      CFE_EVS_SendEvent(LED_CTRL_CHILD_TASK_EID, CFE_EVS_EventType_ERROR,
+                        "Child task epoll_wait failed, child task exiting: %s", strerror(errno));
+      return false;
+   }
+   LedCtrl->ChildWakeupCnt++;
+   if (LedCtrl->ResetPending)
+   {
+      LedCtrl->ChildWakeupCnt = 0;
+      LedCtrl->ResetPending   = false;
+   }
+
+   for (i=0; i < EventCnt; i++)
+   {
+      if (Events[i].data.fd == LedCtrl->Sense.LineFd)
+      {
+         if (!LED_SENSE_ProcessEdges(&LedCtrl->Sense))
+         {
+            epoll_ctl(LedCtrl->EpollFd, EPOLL_CTL_DEL, LedCtrl->Sense.LineFd, NULL);
+         }
+      }
+      else
+      {
+         if (Events[i].data.fd == LedCtrl->TimerFd)
+         {
+            LedCtrl->TimerNs = 0;
+         }
+         if (read(Events[i].data.fd, &Count, sizeof(Count)) < 0) { /* Nonblocking drain */ }
+      }
+   }
+
+   NowNs = LED_CLOCK_Ns(CLOCK_MONOTONIC);
+   if (LedCtrl->Matrix.Enabled && NowNs >= LedCtrl->Matrix.NextRowNs)
+   {
+      LED_MATRIX_ScanRow(&LedCtrl->Matrix, NowNs);
+   }
+   LED_SENSE_CheckTimeout(&LedCtrl->Sense, NowNs);
+
+   LedCtrl->ChildCpuTimeMs = (uint32)(LED_CLOCK_Ns(CLOCK_THREAD_CPUTIME_ID) / LED_CLOCK_NSEC_PER_MSEC);
+
+   return true;
 }
 
 /******************************************************************************
@@ -98,5 +237,156 @@ bool LED_CTRL_ChildTask(CHILDMGR_Class_t* ChildMgr)
 */
 void LED_CTRL_ResetStatus(void)
 {
-   return;
+   LED_SENSE_ResetStatus(&LedCtrl->Sense);
+   LED_MATRIX_ResetStatus(&LedCtrl->Matrix);
+
+   /* The child owns its wakeup counter so it performs the reset */
+   LedCtrl->ResetPending = true;
+   WakeChild();
+}
+
+/******************************************************************************
+** Function: ArmTimer
+**
+** A zero deadline disarms the timer. A deadline in the past expires
+** immediately.
+*/
+static void ArmTimer(uint64 DeadlineNs)
+{
+   struct itimerspec Timer;
+
+   if (DeadlineNs == LedCtrl->TimerNs)
+   {
+      return;
+   }
+
+   memset(&Timer, 0, sizeof(Timer));
+   Timer.it_value.tv_sec  = DeadlineNs / LED_CLOCK_NSEC_PER_SEC;
+   Timer.it_value.tv_nsec = DeadlineNs % LED_CLOCK_NSEC_PER_SEC;
+   timerfd_settime(LedCtrl->TimerFd, TFD_TIMER_ABSTIME, &Timer, NULL);
+
+   LedCtrl->TimerNs = DeadlineNs;
+}
+
+/******************************************************************************
+** Function: DriveOutput
+**
+** PWM commands only need the BCM_REGS backend, which may be simulated, so
+** the level is written through it when rpi_iolib isn't mapped.
+*/
+static void DriveOutput(bool LedOn)
+{
+   if (LedCtrl->IsMapped)
+   {
+      if (LedOn)
+      {
+         gpio_set(LedCtrl->OutPin);
+      }
+      else
+      {
+         gpio_clr(LedCtrl->OutPin);
+      }
+   }
+   else if (LedCtrl->BcmRegs.GpioMapped && LedCtrl->OutPin < BCM_REGS_BANK0_PINS)
+   {
+      LedCtrl->BcmRegs.Gpio[LedOn ? BCM_REGS_GPSET0 : BCM_REGS_GPCLR0] = 1u << LedCtrl->OutPin;
+   }
+}
+
+/******************************************************************************
+** Function: ExpectSense
+**
+** Must be called before the output is driven to LedOn so the resulting edge
+** is matched to the command. The child is woken to arm the readback timeout.
+*/
+static void ExpectSense(bool LedOn)
+{
+   LED_SENSE_Expect(&LedCtrl->Sense, LedOn);
+   if (LED_SENSE_Deadline(&LedCtrl->Sense) != 0)
+   {
+      WakeChild();
+   }
+}
+
+/******************************************************************************
+** Function: InitEventLoop
+**
+** Descriptors are left at -1 on failure so the child task exits.
+*/
+static void InitEventLoop(void)
+{
+   struct epoll_event EpollEvent;
+
+   LedCtrl->EpollFd = epoll_create1(EPOLL_CLOEXEC);
+   LedCtrl->WakeFd  = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+   LedCtrl->TimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+
+   if (LedCtrl->EpollFd < 0 || LedCtrl->WakeFd < 0 || LedCtrl->TimerFd < 0)
+   {
+      CFE_EVS_SendEvent(LED_CTRL_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "Child task event descriptor creation failed: %s", strerror(errno));
+      if (LedCtrl->EpollFd >= 0) close(LedCtrl->EpollFd);
+      if (LedCtrl->WakeFd  >= 0) close(LedCtrl->WakeFd);
+      if (LedCtrl->TimerFd >= 0) close(LedCtrl->TimerFd);
+      LedCtrl->EpollFd = -1;
+      LedCtrl->WakeFd  = -1;
+      LedCtrl->TimerFd = -1;
+      return;
+   }
+
+   memset(&EpollEvent, 0, sizeof(EpollEvent));
+   EpollEvent.events  = EPOLLIN;
+   EpollEvent.data.fd = LedCtrl->WakeFd;
+   epoll_ctl(LedCtrl->EpollFd, EPOLL_CTL_ADD, LedCtrl->WakeFd, &EpollEvent);
+   EpollEvent.data.fd = LedCtrl->TimerFd;
+   epoll_ctl(LedCtrl->EpollFd, EPOLL_CTL_ADD, LedCtrl->TimerFd, &EpollEvent);
+
+   if (LedCtrl->Sense.Enabled)
+   {
+      EpollEvent.data.fd = LedCtrl->Sense.LineFd;
+      epoll_ctl(LedCtrl->EpollFd, EPOLL_CTL_ADD, LedCtrl->Sense.LineFd, &EpollEvent);
+   }
+}
+
+/******************************************************************************
+** Function: NextDeadline
+**
+** Return the earliest matrix row or readback deadline, 0 if there is none.
+*/
+static uint64 NextDeadline(void)
+{
+   uint64 DeadlineNs = 0;
+   uint64 SenseNs    = LED_SENSE_Deadline(&LedCtrl->Sense);
+
+   if (LedCtrl->Matrix.Enabled)
+   {
+      DeadlineNs = LedCtrl->Matrix.NextRowNs;
+   }
+   if (SenseNs != 0 && (DeadlineNs == 0 || SenseNs < DeadlineNs))
+   {
+      DeadlineNs = SenseNs;
+   }
+
+   return DeadlineNs;
+}
+
+/******************************************************************************
+** Function: WakeChild
+**
+** The child task recomputes its timer deadline every time it wakes.
+*/
+static void WakeChild(void)
+{
+   uint64 Wake = 1;
+
+   if (LedCtrl->WakeFd < 0)
+   {
+      return;  /* Child task has exited, see InitEventLoop() */
+   }
+
+   if (write(LedCtrl->WakeFd, &Wake, sizeof(Wake)) < 0)
+   {
+      CFE_EVS_SendEvent(LED_CTRL_CHILD_TASK_EID, CFE_EVS_EventType_ERROR,
+                        "Child task wakeup failed: %s", strerror(errno));
+   }
 }
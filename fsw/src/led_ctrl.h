@@ -17,6 +17,10 @@
 **
 **  Notes:
 **    TODO - Consider adding a map command if it fails during init. 
+**    1. The child task is an event loop that blocks on a single epoll set
+**       containing an eventfd for command wakeups, a timerfd armed at the
+**       earliest matrix row or readback deadline, and the sense line. It
+**       uses no CPU while there is nothing to do.
 **
 */
 
@@ -27,6 +31,10 @@
 ** Includes
 */
 #include "app_cfg.h"
+#include "bcm_regs.h"
+#include "led_matrix.h"
+#include "led_pwm.h"
+#include "led_sense.h"
 
 /***********************/
 /** Macro Definitions **/
@@ -37,6 +45,9 @@
 */
 #define LED_CTRL_CONSTRUCTOR_EID  (LED_CTRL_BASE_EID + 0)
 #define LED_CTRL_CHILD_TASK_EID   (LED_CTRL_BASE_EID + 1)
+#define LED_CTRL_PWM_EID          (LED_CTRL_BASE_EID + 2)
+
+#define LED_CTRL_EPOLL_EVENTS  3   /* Wake, timer and sense line descriptors */
 
 /**********************/
 /** Type Definitions **/
@@ -51,6 +62,19 @@ typedef struct
    bool    IsMapped;
    bool    LedOn;
    uint8   OutPin;
+   LED_SENSE_Class_t  Sense;
+   LED_MATRIX_Class_t Matrix;
+   LED_PWM_Class_t    Pwm;
+   BCM_REGS_Class_t   BcmRegs;
+
+   /* Child task event loop */
+   int     EpollFd;
+   int     WakeFd;
+   int     TimerFd;
+   uint64  TimerNs;          /* Armed CLOCK_MONOTONIC deadline, 0 if disarmed */
+   bool    ResetPending;     /* Set by the main task, cleared by the child */
+   uint32  ChildWakeupCnt;
+   uint32  ChildCpuTimeMs;   /* 32 bits so the main task reads it atomically */
 } LED_CTRL_Class_t;
 
 /************************/
@@ -82,4 +106,20 @@ bool LED_CTRL_TurnOnCmd(void *DataObjPtr, const CFE_MSG_Message_t *MsgPtr);
 */
 bool LED_CTRL_TurnOffCmd(void *DataObjPtr, const CFE_MSG_Message_t *MsgPtr);
 
+/******************************************************************************
+** Function: LED_CTRL_SetPwmCmd
+**
+** Notes:
+**   1. Readback is suspended while the PWM output is active
+*/
+bool LED_CTRL_SetPwmCmd(void *DataObjPtr, const CFE_MSG_Message_t *MsgPtr);
+
+/******************************************************************************
+** Function: LED_CTRL_StopPwmCmd
+**
+** Notes:
+**   1. The LED is returned to its last on/off commanded state
+*/
+bool LED_CTRL_StopPwmCmd(void *DataObjPtr, const CFE_MSG_Message_t *MsgPtr);
+
 #endif /* _led_ctrl_ */
@@ -0,0 +1,514 @@
+/*
+**  Copyright 2022 bitValence, Inc.
+**  All Rights Reserved.
+**
+**  This program is free software; you can modify and/or redistribute it
+**  under the terms of the GNU Affero General Public License
+**  as published by the Free Software Foundation; version 3 with
+**  attribution addendums as found in the LICENSE.txt
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Affero General Public License for more details.
+**
+**  Purpose:
+**    Implement the row/column multiplexed LED matrix class methods
+**
+**  Notes:
+**    1. Row deadlines are absolute CLOCK_MONOTONIC times so wakeup and
+**       register write overhead doesn't accumulate into refresh rate drift.
+**    2. Scan jitter is the time between a row's deadline and the child
+**       task waking to write it.
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "app_cfg.h"
+#include "led_clock.h"
+#include "led_matrix.h"
+#include "rpi_led_eds_cc.h"
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static uint32 BenchGpio[BCM_REGS_BLOCK_WORDS];
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static void   ComputeMasks(LED_MATRIX_Class_t *LedMatrix, uint8 Buf);
+static bool   ParsePinList(const char *PinList, const char *ListName, uint8 *Pin, uint8 *PinCnt);
+static void   UpdateScanStats(LED_MATRIX_Class_t *LedMatrix, uint64 NowNs);
+
+
+/******************************************************************************
+** Function: LED_MATRIX_Constructor
+**
+*/
+void LED_MATRIX_Constructor(LED_MATRIX_Class_t *LedMatrix, INITBL_Class_t *IniTbl,
+                            BCM_REGS_Class_t *BcmRegs)
+{
+
+   const char *RowPins = INITBL_GetStrConfig(IniTbl, CFG_MATRIX_ROW_PINS);
+   const char *ColPins = INITBL_GetStrConfig(IniTbl, CFG_MATRIX_COL_PINS);
+   uint32 PinBit, OutPin, BlankSet = 0;
+   uint8  i;
+
+   memset(LedMatrix, 0, sizeof(LED_MATRIX_Class_t));
+   LedMatrix->BcmRegs = BcmRegs;
+
+   if (RowPins[0] == '\0' && ColPins[0] == '\0')
+   {
+      return;
+   }
+
+   if (!ParsePinList(RowPins, "row", LedMatrix->RowPin, &LedMatrix->Rows) ||
+       !ParsePinList(ColPins, "column", LedMatrix->ColPin, &LedMatrix->Cols))
+   {
+      return;
+   }
+
+   LedMatrix->RefreshHz     = INITBL_GetIntConfig(IniTbl, CFG_MATRIX_REFRESH_HZ);
+   LedMatrix->RowActiveHigh = (INITBL_GetIntConfig(IniTbl, CFG_MATRIX_ROW_ACTIVE_HIGH) != 0);
+   LedMatrix->ColActiveHigh = (INITBL_GetIntConfig(IniTbl, CFG_MATRIX_COL_ACTIVE_HIGH) != 0);
+
+   if (LedMatrix->RefreshHz < LED_MATRIX_MIN_REFRESH_HZ ||
+       LedMatrix->RefreshHz > LED_MATRIX_MAX_REFRESH_HZ)
+   {
+      CFE_EVS_SendEvent(LED_MATRIX_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "Matrix disabled. Refresh rate %d Hz not in range %d..%d",
+                        LedMatrix->RefreshHz, LED_MATRIX_MIN_REFRESH_HZ, LED_MATRIX_MAX_REFRESH_HZ);
+      return;
+   }
+
+   for (i=0; i < LedMatrix->Rows + LedMatrix->Cols; i++)
+   {
+      PinBit = 1u << ((i < LedMatrix->Rows) ? LedMatrix->RowPin[i] : LedMatrix->ColPin[i-LedMatrix->Rows]);
+      if (LedMatrix->PinMask & PinBit)
+      {
+         CFE_EVS_SendEvent(LED_MATRIX_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                           "Matrix disabled. Row and column pin lists contain duplicate pins");
+         return;
+      }
+      LedMatrix->PinMask |= PinBit;
+   }
+
+   OutPin = INITBL_GetIntConfig(IniTbl, CFG_CTRL_OUT_PIN);
+   if (OutPin < 32 && (LedMatrix->PinMask & (1u << OutPin)))
+   {
+      CFE_EVS_SendEvent(LED_MATRIX_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "Matrix disabled. LED output pin %d is also a matrix pin", OutPin);
+      return;
+   }
+
+   if (!BCM_REGS_MapGpio(BcmRegs))
+   {
+      return;  /* Map function sends error event */
+   }
+
+   if (OS_MutSemCreate(&LedMatrix->MutexId, "RPI_LED_MATRIX", 0) != OS_SUCCESS)
+   {
+      CFE_EVS_SendEvent(LED_MATRIX_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "Matrix disabled. Mutex creation failed");
+      return;
+   }
+
+   LedMatrix->RowPeriodNs = LED_CLOCK_NSEC_PER_SEC / (LedMatrix->RefreshHz * LedMatrix->Rows);
+
+   if (LedMatrix->RowActiveHigh)
+   {
+      LedMatrix->FirstReg  = &BcmRegs->Gpio[BCM_REGS_GPCLR0];
+      LedMatrix->SecondReg = &BcmRegs->Gpio[BCM_REGS_GPSET0];
+   }
+   else
+   {
+      LedMatrix->FirstReg  = &BcmRegs->Gpio[BCM_REGS_GPSET0];
+      LedMatrix->SecondReg = &BcmRegs->Gpio[BCM_REGS_GPCLR0];
+   }
+
+   ComputeMasks(LedMatrix, 0);
+   ComputeMasks(LedMatrix, 1);
+
+   LedMatrix->NextRowNs     = LED_CLOCK_Ns(CLOCK_MONOTONIC);
+   LedMatrix->WindowStartNs = LedMatrix->NextRowNs;
+
+   /* Drive every pin inactive before enabling the outputs */
+   for (i=0; i < LedMatrix->Rows; i++)
+   {
+      if (!LedMatrix->RowActiveHigh) BlankSet |= 1u << LedMatrix->RowPin[i];
+   }
+   for (i=0; i < LedMatrix->Cols; i++)
+   {
+      if (!LedMatrix->ColActiveHigh) BlankSet |= 1u << LedMatrix->ColPin[i];
+   }
+   BcmRegs->Gpio[BCM_REGS_GPCLR0] = LedMatrix->PinMask & ~BlankSet;
+   BcmRegs->Gpio[BCM_REGS_GPSET0] = BlankSet;
+
+   for (i=0; i < LedMatrix->Rows; i++)
+   {
+      BCM_REGS_SetPinFunc(BcmRegs, LedMatrix->RowPin[i], BCM_REGS_FSEL_OUTPUT);
+   }
+   for (i=0; i < LedMatrix->Cols; i++)
+   {
+      BCM_REGS_SetPinFunc(BcmRegs, LedMatrix->ColPin[i], BCM_REGS_FSEL_OUTPUT);
+   }
+
+   LedMatrix->Enabled = true;
+   CFE_EVS_SendEvent(LED_MATRIX_CONSTRUCTOR_EID, CFE_EVS_EventType_INFORMATION,
+                     "Matrix enabled: %dx%d at %d Hz, %d ns per row",
+                     LedMatrix->Rows, LedMatrix->Cols, LedMatrix->RefreshHz, LedMatrix->RowPeriodNs);
+
+} /* End LED_MATRIX_Constructor() */
+
+
+/******************************************************************************
+** Function: LED_MATRIX_ScanRow
+**
+*/
+void LED_MATRIX_ScanRow(LED_MATRIX_Class_t *LedMatrix, uint64 NowNs)
+{
+
+   const LED_MATRIX_RowMask_t *Mask;
+
+   if (LedMatrix->ScanRow == 0)
+   {
+      OS_MutSemTake(LedMatrix->MutexId);
+      if (LedMatrix->SwapPending)
+      {
+         LedMatrix->Front ^= 1;
+         LedMatrix->SwapPending = false;
+      }
+      if (LedMatrix->ResetPending)
+      {
+         LedMatrix->FrameCnt     = 0;
+         LedMatrix->ResetPending = false;
+      }
+      OS_MutSemGive(LedMatrix->MutexId);
+   }
+
+   Mask = &LedMatrix->Mask[LedMatrix->Front][LedMatrix->ScanRow];
+   *LedMatrix->FirstReg  = Mask->First;
+   *LedMatrix->SecondReg = Mask->Second;
+
+   UpdateScanStats(LedMatrix, NowNs);
+
+   if (++LedMatrix->ScanRow >= LedMatrix->Rows)
+   {
+      LedMatrix->ScanRow = 0;
+      LedMatrix->FrameCnt++;
+      LedMatrix->WindowFrameCnt++;
+   }
+
+   /* Skip missed deadlines rather than bursting to catch up */
+   LedMatrix->NextRowNs += LedMatrix->RowPeriodNs;
+   if (LedMatrix->NextRowNs < NowNs)
+   {
+      LedMatrix->NextRowNs = NowNs;
+   }
+
+} /* End LED_MATRIX_ScanRow() */
+
+
+/******************************************************************************
+** Function: LED_MATRIX_ResetStatus
+**
+*/
+void LED_MATRIX_ResetStatus(LED_MATRIX_Class_t *LedMatrix)
+{
+
+   if (!LedMatrix->Enabled)
+   {
+      return;
+   }
+
+   /* FrameCnt is owned by the child task so it's reset at the next frame */
+   OS_MutSemTake(LedMatrix->MutexId);
+   LedMatrix->ResetPending = true;
+   OS_MutSemGive(LedMatrix->MutexId);
+
+} /* End LED_MATRIX_ResetStatus() */
+
+
+/******************************************************************************
+** Function: LED_MATRIX_SetFrameCmd
+**
+*/
+bool LED_MATRIX_SetFrameCmd(void *DataObjPtr, const CFE_MSG_Message_t *MsgPtr)
+{
+
+   LED_MATRIX_Class_t *LedMatrix = (LED_MATRIX_Class_t *)DataObjPtr;
+   const RPI_LED_MatrixSetFrame_CmdPayload_t *Cmd = CMDMGR_PAYLOAD_PTR(MsgPtr, RPI_LED_MatrixSetFrame_t);
+   uint16 ColMask;
+   uint8  Row;
+
+   if (!LedMatrix->Enabled)
+   {
+      CFE_EVS_SendEvent(LED_MATRIX_SET_FRAME_EID, CFE_EVS_EventType_ERROR,
+                        "Set matrix frame rejected, matrix mode is not enabled");
+      return false;
+   }
+
+   ColMask = (uint16)((1u << LedMatrix->Cols) - 1);
+
+   OS_MutSemTake(LedMatrix->MutexId);
+   for (Row=0; Row < LedMatrix->Rows; Row++)
+   {
+      LedMatrix->Frame[Row] = Cmd->Frame[Row] & ColMask;
+   }
+   ComputeMasks(LedMatrix, LedMatrix->Front ^ 1);
+   LedMatrix->SwapPending = true;
+   OS_MutSemGive(LedMatrix->MutexId);
+
+   CFE_EVS_SendEvent(LED_MATRIX_SET_FRAME_EID, CFE_EVS_EventType_DEBUG,
+                     "Matrix frame updated");
+
+   return true;
+
+} /* End LED_MATRIX_SetFrameCmd() */
+
+
+/******************************************************************************
+** Function: LED_MATRIX_SetRegionCmd
+**
+*/
+bool LED_MATRIX_SetRegionCmd(void *DataObjPtr, const CFE_MSG_Message_t *MsgPtr)
+{
+
+   LED_MATRIX_Class_t *LedMatrix = (LED_MATRIX_Class_t *)DataObjPtr;
+   const RPI_LED_MatrixSetRegion_CmdPayload_t *Cmd = CMDMGR_PAYLOAD_PTR(MsgPtr, RPI_LED_MatrixSetRegion_t);
+   uint16 RegionMask;
+   uint8  Row;
+
+   if (!LedMatrix->Enabled)
+   {
+      CFE_EVS_SendEvent(LED_MATRIX_SET_REGION_EID, CFE_EVS_EventType_ERROR,
+                        "Set matrix region rejected, matrix mode is not enabled");
+      return false;
+   }
+
+   if (Cmd->Height == 0 || Cmd->Width == 0 ||
+       (Cmd->RowStart + Cmd->Height) > LedMatrix->Rows ||
+       (Cmd->ColStart + Cmd->Width)  > LedMatrix->Cols)
+   {
+      CFE_EVS_SendEvent(LED_MATRIX_SET_REGION_EID, CFE_EVS_EventType_ERROR,
+                        "Set matrix region rejected, %dx%d region at (%d,%d) not within %dx%d matrix",
+                        Cmd->Height, Cmd->Width, Cmd->RowStart, Cmd->ColStart,
+                        LedMatrix->Rows, LedMatrix->Cols);
+      return false;
+   }
+
+   RegionMask = (uint16)(((1u << Cmd->Width) - 1) << Cmd->ColStart);
+
+   OS_MutSemTake(LedMatrix->MutexId);
+   for (Row=0; Row < Cmd->Height; Row++)
+   {
+      LedMatrix->Frame[Cmd->RowStart + Row] = (LedMatrix->Frame[Cmd->RowStart + Row] & ~RegionMask) |
+                                              ((Cmd->Frame[Row] << Cmd->ColStart) & RegionMask);
+   }
+   ComputeMasks(LedMatrix, LedMatrix->Front ^ 1);
+   LedMatrix->SwapPending = true;
+   OS_MutSemGive(LedMatrix->MutexId);
+
+   CFE_EVS_SendEvent(LED_MATRIX_SET_REGION_EID, CFE_EVS_EventType_DEBUG,
+                     "Matrix %dx%d region at (%d,%d) updated",
+                     Cmd->Height, Cmd->Width, Cmd->RowStart, Cmd->ColStart);
+
+   return true;
+
+} /* End LED_MATRIX_SetRegionCmd() */
+
+
+/******************************************************************************
+** Function: LED_MATRIX_RunBenchmarkCmd
+**
+*/
+bool LED_MATRIX_RunBenchmarkCmd(void *DataObjPtr, const CFE_MSG_Message_t *MsgPtr)
+{
+
+   LED_MATRIX_Class_t *LedMatrix = (LED_MATRIX_Class_t *)DataObjPtr;
+   const RPI_LED_MatrixRunBenchmark_CmdPayload_t *Cmd = CMDMGR_PAYLOAD_PTR(MsgPtr, RPI_LED_MatrixRunBenchmark_t);
+   const LED_MATRIX_RowMask_t *Mask;
+   volatile uint32 *FirstReg;
+   volatile uint32 *SecondReg;
+   uint64 StartNs, FrameStartNs, EndNs, FrameNs, MaxFrameNs = 0;
+   uint32 Frame;
+   uint8  Row;
+
+   if (!LedMatrix->Enabled)
+   {
+      CFE_EVS_SendEvent(LED_MATRIX_BENCHMARK_EID, CFE_EVS_EventType_ERROR,
+                        "Matrix benchmark rejected, matrix mode is not enabled");
+      return false;
+   }
+
+   if (Cmd->Frames == 0 || Cmd->Frames > LED_MATRIX_MAX_BENCH_FRAMES)
+   {
+      CFE_EVS_SendEvent(LED_MATRIX_BENCHMARK_EID, CFE_EVS_EventType_ERROR,
+                        "Matrix benchmark rejected, frame count %d not in range 1..%d",
+                        Cmd->Frames, LED_MATRIX_MAX_BENCH_FRAMES);
+      return false;
+   }
+
+   /* Main task owns the back buffer so only the front buffer can change */
+   OS_MutSemTake(LedMatrix->MutexId);
+   Mask = LedMatrix->Mask[LedMatrix->Front];
+   OS_MutSemGive(LedMatrix->MutexId);
+
+   FirstReg  = &BenchGpio[LedMatrix->FirstReg  - LedMatrix->BcmRegs->Gpio];
+   SecondReg = &BenchGpio[LedMatrix->SecondReg - LedMatrix->BcmRegs->Gpio];
+
+   StartNs = LED_CLOCK_Ns(CLOCK_MONOTONIC);
+   EndNs   = StartNs;
+   for (Frame=0; Frame < Cmd->Frames; Frame++)
+   {
+      FrameStartNs = EndNs;
+      for (Row=0; Row < LedMatrix->Rows; Row++)
+      {
+         *FirstReg  = Mask[Row].First;
+         *SecondReg = Mask[Row].Second;
+      }
+      EndNs   = LED_CLOCK_Ns(CLOCK_MONOTONIC);
+      FrameNs = EndNs - FrameStartNs;
+      if (FrameNs > MaxFrameNs)
+      {
+         MaxFrameNs = FrameNs;
+      }
+   }
+
+   CFE_EVS_SendEvent(LED_MATRIX_BENCHMARK_EID, CFE_EVS_EventType_INFORMATION,
+                     "Matrix benchmark: %d frames x %d rows, 2 register writes per row, avg %d ns/row, max %d ns/frame",
+                     Cmd->Frames, LedMatrix->Rows,
+                     (int)((EndNs - StartNs) / ((uint64)Cmd->Frames * LedMatrix->Rows)), (int)MaxFrameNs);
+
+   return true;
+
+} /* End LED_MATRIX_RunBenchmarkCmd() */
+
+
+/******************************************************************************
+** Function: ComputeMasks
+**
+** Precompute the register masks for each row of the framebuffer so the scan
+** loop does no per-pixel work.
+*/
+static void ComputeMasks(LED_MATRIX_Class_t *LedMatrix, uint8 Buf)
+{
+
+   LED_MATRIX_RowMask_t *Mask = LedMatrix->Mask[Buf];
+   uint32 SetMask, ClrMask;
+   uint8  Row, i;
+   bool   Lit;
+
+   for (Row=0; Row < LedMatrix->Rows; Row++)
+   {
+      SetMask = 0;
+      for (i=0; i < LedMatrix->Rows; i++)
+      {
+         if ((i == Row) == LedMatrix->RowActiveHigh)
+         {
+            SetMask |= 1u << LedMatrix->RowPin[i];
+         }
+      }
+      for (i=0; i < LedMatrix->Cols; i++)
+      {
+         Lit = ((LedMatrix->Frame[Row] >> i) & 1) != 0;
+         if (Lit == LedMatrix->ColActiveHigh)
+         {
+            SetMask |= 1u << LedMatrix->ColPin[i];
+         }
+      }
+      ClrMask = LedMatrix->PinMask & ~SetMask;
+
+      Mask[Row].First  = LedMatrix->RowActiveHigh ? ClrMask : SetMask;
+      Mask[Row].Second = LedMatrix->RowActiveHigh ? SetMask : ClrMask;
+   }
+
+} /* End ComputeMasks() */
+
+
+/******************************************************************************
+** Function: ParsePinList
+**
+** Parse a comma separated list of bank 0 GPIO pin numbers.
+*/
+static bool ParsePinList(const char *PinList, const char *ListName, uint8 *Pin, uint8 *PinCnt)
+{
+
+   const char *Next = PinList;
+   char *End;
+   unsigned long Value;
+
+   *PinCnt = 0;
+
+   while (*Next != '\0')
+   {
+      Value = strtoul(Next, &End, 10);
+      if (End == Next || Value >= BCM_REGS_BANK0_PINS || *PinCnt >= LED_MATRIX_MAX_DIM)
+      {
+         CFE_EVS_SendEvent(LED_MATRIX_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                           "Matrix disabled. Invalid %s pin list '%s', expected up to %d pins in 0..%d",
+                           ListName, PinList, LED_MATRIX_MAX_DIM, BCM_REGS_BANK0_PINS-1);
+         return false;
+      }
+      Pin[(*PinCnt)++] = (uint8)Value;
+
+      Next = End;
+      while (*Next == ',' || *Next == ' ')
+      {
+         Next++;
+      }
+   }
+
+   if (*PinCnt == 0)
+   {
+      CFE_EVS_SendEvent(LED_MATRIX_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "Matrix disabled. The %s pin list is empty", ListName);
+      return false;
+   }
+
+   return true;
+
+} /* End ParsePinList() */
+
+
+/******************************************************************************
+** Function: UpdateScanStats
+**
+** Accumulate row jitter and publish refresh rate and jitter once per second.
+*/
+static void UpdateScanStats(LED_MATRIX_Class_t *LedMatrix, uint64 NowNs)
+{
+
+   uint64 JitterNs = NowNs - LedMatrix->NextRowNs;
+   uint64 WindowNs = NowNs - LedMatrix->WindowStartNs;
+
+   LedMatrix->WindowJitterSumNs += JitterNs;
+   LedMatrix->WindowRowCnt++;
+   if (JitterNs > LedMatrix->WindowJitterMaxNs)
+   {
+      LedMatrix->WindowJitterMaxNs = (JitterNs > UINT32_MAX) ? UINT32_MAX : (uint32)JitterNs;
+   }
+
+   if (WindowNs >= LED_CLOCK_NSEC_PER_SEC)
+   {
+      LedMatrix->RefreshMilliHz = (uint32)((uint64)LedMatrix->WindowFrameCnt * 1000 * LED_CLOCK_NSEC_PER_SEC / WindowNs);
+      LedMatrix->JitterAvgUs    = (uint32)(LedMatrix->WindowJitterSumNs / LedMatrix->WindowRowCnt / 1000);
+      LedMatrix->JitterMaxUs    = LedMatrix->WindowJitterMaxNs / 1000;
+
+      LedMatrix->WindowStartNs     = NowNs;
+      LedMatrix->WindowFrameCnt    = 0;
+      LedMatrix->WindowJitterSumNs = 0;
+      LedMatrix->WindowJitterMaxNs = 0;
+      LedMatrix->WindowRowCnt      = 0;
+   }
+
+} /* End UpdateScanStats() */
@@ -0,0 +1,173 @@
+/*
+**  Copyright 2022 bitValence, Inc.
+**  All Rights Reserved.
+**
+**  This program is free software; you can modify and/or redistribute it
+**  under the terms of the GNU Affero General Public License
+**  as published by the Free Software Foundation; version 3 with
+**  attribution addendums as found in the LICENSE.txt
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Affero General Public License for more details.
+**
+**  Purpose:
+**    Define row/column multiplexed LED matrix class
+**
+**  Notes:
+**    1. Matrix mode is enabled when row and column pin lists are defined
+**       in the ini file. All pins must be in GPIO bank 0 (0..31) so each
+**       row is displayed with exactly two register writes. The LED output
+**       pin can't be a matrix pin.
+**    2. Each framebuffer row is a bitmap, bit n is column n. Commands
+**       edit a pending framebuffer and precompute its per-row set/clear
+**       masks. The child task swaps to the new masks at a frame boundary
+**       so a frame is never displayed partially updated.
+**    3. The child task calls ScanRow() when NextRowNs is reached. The
+**       matrix never blocks so it can share the child's event loop.
+**    4. Refresh rate and scan jitter are measured over one second windows.
+**
+*/
+
+#ifndef _led_matrix_
+#define _led_matrix_
+
+/*
+** Includes
+*/
+#include "app_cfg.h"
+#include "bcm_regs.h"
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define LED_MATRIX_MAX_DIM   16   /* Must match EDS MatrixFrame dimension */
+
+#define LED_MATRIX_MIN_REFRESH_HZ      1
+#define LED_MATRIX_MAX_REFRESH_HZ   2000
+#define LED_MATRIX_MAX_BENCH_FRAMES 10000
+
+/*
+** Event Message IDs
+*/
+#define LED_MATRIX_CONSTRUCTOR_EID  (LED_MATRIX_BASE_EID + 0)
+#define LED_MATRIX_SET_FRAME_EID    (LED_MATRIX_BASE_EID + 1)
+#define LED_MATRIX_SET_REGION_EID   (LED_MATRIX_BASE_EID + 2)
+#define LED_MATRIX_BENCHMARK_EID    (LED_MATRIX_BASE_EID + 3)
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+/******************************************************************************
+** Row register masks
+**
+** First is written to the register that deactivates the row pins so the
+** new column pattern is never driven onto the previous row.
+*/
+typedef struct
+{
+   uint32  First;
+   uint32  Second;
+
+} LED_MATRIX_RowMask_t;
+
+/******************************************************************************
+** LED_MATRIX_Class
+**
+** - Frame, Mask[!Front], SwapPending and ResetPending are protected by
+**   MutexId. Front is only changed by the child task while holding the mutex.
+*/
+typedef struct
+{
+   bool    Enabled;
+   uint8   Rows;
+   uint8   Cols;
+   uint8   RowPin[LED_MATRIX_MAX_DIM];
+   uint8   ColPin[LED_MATRIX_MAX_DIM];
+   bool    RowActiveHigh;
+   bool    ColActiveHigh;
+   uint32  RefreshHz;
+   uint32  RowPeriodNs;
+   uint32  PinMask;        /* All row and column pins */
+
+   uint16  Frame[LED_MATRIX_MAX_DIM];
+   LED_MATRIX_RowMask_t Mask[2][LED_MATRIX_MAX_DIM];
+   uint8   Front;
+   bool    SwapPending;
+   bool    ResetPending;   /* FrameCnt reset requested by the main task */
+   uint32  FrameCnt;
+
+   /* Scan state, owned by the child task */
+   uint8   ScanRow;
+   uint64  NextRowNs;
+   uint64  WindowStartNs;
+   uint32  WindowFrameCnt;
+   uint64  WindowJitterSumNs;
+   uint32  WindowJitterMaxNs;
+   uint32  WindowRowCnt;
+
+   /* Last completed measurement window */
+   uint32  RefreshMilliHz;
+   uint32  JitterAvgUs;
+   uint32  JitterMaxUs;
+
+   BCM_REGS_Class_t *BcmRegs;
+   volatile uint32  *FirstReg;
+   volatile uint32  *SecondReg;
+   osal_id_t MutexId;
+
+} LED_MATRIX_Class_t;
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+/******************************************************************************
+** Function: LED_MATRIX_Constructor
+**
+** Notes:
+**   1. Empty pin lists disable matrix mode and are not an error.
+*/
+void LED_MATRIX_Constructor(LED_MATRIX_Class_t *LedMatrix, INITBL_Class_t *IniTbl,
+                            BCM_REGS_Class_t *BcmRegs);
+
+/******************************************************************************
+** Function: LED_MATRIX_ScanRow
+**
+** Display the next row and advance NextRowNs. A pending frame is applied
+** before the first row.
+*/
+void LED_MATRIX_ScanRow(LED_MATRIX_Class_t *LedMatrix, uint64 NowNs);
+
+/******************************************************************************
+** Function: LED_MATRIX_ResetStatus
+*/
+void LED_MATRIX_ResetStatus(LED_MATRIX_Class_t *LedMatrix);
+
+/******************************************************************************
+** Function: LED_MATRIX_SetFrameCmd
+*/
+bool LED_MATRIX_SetFrameCmd(void *DataObjPtr, const CFE_MSG_Message_t *MsgPtr);
+
+/******************************************************************************
+** Function: LED_MATRIX_SetRegionCmd
+**
+** Notes:
+**   1. Bit n of payload row i is pixel (RowStart+i, ColStart+n)
+*/
+bool LED_MATRIX_SetRegionCmd(void *DataObjPtr, const CFE_MSG_Message_t *MsgPtr);
+
+/******************************************************************************
+** Function: LED_MATRIX_RunBenchmarkCmd
+**
+** Notes:
+**   1. Scans the current frame as fast as possible against an in-memory
+**      register file and reports the per row cost in an event message.
+**      The command pipe is blocked while it runs.
+*/
+bool LED_MATRIX_RunBenchmarkCmd(void *DataObjPtr, const CFE_MSG_Message_t *MsgPtr);
+
+#endif /* _led_matrix_ */
@@ -0,0 +1,460 @@
+/*
+**  Copyright 2022 bitValence, Inc.
+**  All Rights Reserved.
+**
+**  This program is free software; you can modify and/or redistribute it
+**  under the terms of the GNU Affero General Public License
+**  as published by the Free Software Foundation; version 3 with
+**  attribution addendums as found in the LICENSE.txt
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Affero General Public License for more details.
+**
+**  Purpose:
+**    Implement the LED hardware PWM driver class methods
+**
+**  Notes:
+**    1. The clock manager must be disabled and idle before its divisor is
+**       changed, see the BCM2835 ARM Peripherals manual section 6.3.
+**    2. Only pins on the 40-pin header are listed in the function table.
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <string.h>
+#include <unistd.h>
+
+#include "app_cfg.h"
+#include "led_pwm.h"
+#include "rpi_led_eds_cc.h"
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+typedef struct
+{
+   uint8  Pin;
+   uint8  Periph;
+   uint8  Channel;
+   uint8  AltFunc;
+
+} PinFunc_t;
+
+static const PinFunc_t PinFuncTbl[] =
+{
+   {  4, LED_PWM_PERIPH_GPCLK, 0, BCM_REGS_FSEL_ALT0 },
+   {  5, LED_PWM_PERIPH_GPCLK, 1, BCM_REGS_FSEL_ALT0 },
+   {  6, LED_PWM_PERIPH_GPCLK, 2, BCM_REGS_FSEL_ALT0 },
+   { 12, LED_PWM_PERIPH_PWM,   0, BCM_REGS_FSEL_ALT0 },
+   { 13, LED_PWM_PERIPH_PWM,   1, BCM_REGS_FSEL_ALT0 },
+   { 18, LED_PWM_PERIPH_PWM,   0, BCM_REGS_FSEL_ALT5 },
+   { 19, LED_PWM_PERIPH_PWM,   1, BCM_REGS_FSEL_ALT5 },
+   { 20, LED_PWM_PERIPH_GPCLK, 0, BCM_REGS_FSEL_ALT5 },
+   { 21, LED_PWM_PERIPH_GPCLK, 1, BCM_REGS_FSEL_ALT5 }
+};
+
+static BCM_REGS_Class_t CheckRegs;  /* Simulated register file for CheckRegsCmd() */
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static bool CheckGpclkRegs(LED_PWM_Class_t *LedPwm, uint32 FreqHz);
+static bool CheckPwmRegs(LED_PWM_Class_t *LedPwm, uint32 FreqHz, uint16 DutyPermille);
+static bool SetClock(LED_PWM_Class_t *LedPwm, uint32 CtlReg, uint32 DivReg,
+                     uint32 Divisor, uint32 Mash);
+static bool StartGpclk(LED_PWM_Class_t *LedPwm, uint32 FreqHz, uint16 DutyPermille);
+static bool StartPwm(LED_PWM_Class_t *LedPwm, uint32 FreqHz, uint16 DutyPermille);
+
+
+/******************************************************************************
+** Function: LED_PWM_Constructor
+**
+*/
+void LED_PWM_Constructor(LED_PWM_Class_t *LedPwm, BCM_REGS_Class_t *BcmRegs,
+                         uint8 Pin, uint32 OscHz)
+{
+
+   uint8 i;
+
+   memset(LedPwm, 0, sizeof(LED_PWM_Class_t));
+   LedPwm->BcmRegs = BcmRegs;
+   LedPwm->Pin     = Pin;
+   LedPwm->OscHz   = OscHz;
+   LedPwm->Periph  = LED_PWM_PERIPH_NONE;
+
+   for (i=0; i < (sizeof(PinFuncTbl)/sizeof(PinFunc_t)); i++)
+   {
+      if (PinFuncTbl[i].Pin == Pin)
+      {
+         LedPwm->Periph  = PinFuncTbl[i].Periph;
+         LedPwm->Channel = PinFuncTbl[i].Channel;
+         LedPwm->AltFunc = PinFuncTbl[i].AltFunc;
+         break;
+      }
+   }
+
+   if (LedPwm->Periph == LED_PWM_PERIPH_NONE)
+   {
+      CFE_EVS_SendEvent(LED_PWM_CONSTRUCTOR_EID, CFE_EVS_EventType_INFORMATION,
+                        "GPIO pin %d has no PWM or GPCLK function, only on/off control is available", Pin);
+   }
+
+} /* End LED_PWM_Constructor() */
+
+
+/******************************************************************************
+** Function: LED_PWM_Start
+**
+*/
+bool LED_PWM_Start(LED_PWM_Class_t *LedPwm, uint32 FreqHz, uint16 DutyPermille)
+{
+
+   bool RetStatus;
+
+   if (LedPwm->Periph == LED_PWM_PERIPH_NONE)
+   {
+      CFE_EVS_SendEvent(LED_PWM_START_EID, CFE_EVS_EventType_ERROR,
+                        "PWM rejected, GPIO pin %d has no PWM or GPCLK function", LedPwm->Pin);
+      return false;
+   }
+
+   if (!BCM_REGS_MapGpio(LedPwm->BcmRegs) || !BCM_REGS_MapPeriph(LedPwm->BcmRegs))
+   {
+      return false;  /* Map functions send error events */
+   }
+
+   if (LedPwm->Periph == LED_PWM_PERIPH_PWM)
+   {
+      RetStatus = StartPwm(LedPwm, FreqHz, DutyPermille);
+   }
+   else
+   {
+      RetStatus = StartGpclk(LedPwm, FreqHz, DutyPermille);
+   }
+
+   if (RetStatus)
+   {
+      BCM_REGS_SetPinFunc(LedPwm->BcmRegs, LedPwm->Pin, LedPwm->AltFunc);
+      LedPwm->Active       = true;
+      LedPwm->DutyPermille = DutyPermille;
+      CFE_EVS_SendEvent(LED_PWM_START_EID, CFE_EVS_EventType_INFORMATION,
+                        "GPIO pin %d %s%d output started at %d Hz with %d.%d%% duty",
+                        LedPwm->Pin, (LedPwm->Periph == LED_PWM_PERIPH_PWM) ? "PWM" : "GPCLK",
+                        LedPwm->Channel, LedPwm->FreqHz, DutyPermille/10, DutyPermille%10);
+   }
+
+   return RetStatus;
+
+} /* End LED_PWM_Start() */
+
+
+/******************************************************************************
+** Function: LED_PWM_Stop
+**
+*/
+void LED_PWM_Stop(LED_PWM_Class_t *LedPwm)
+{
+
+   uint32 ChanShift = LedPwm->Channel * BCM_REGS_PWM_CTL_CHAN_SHIFT;
+
+   if (!LedPwm->Active)
+   {
+      return;
+   }
+
+   if (LedPwm->Periph == LED_PWM_PERIPH_PWM)
+   {
+      LedPwm->BcmRegs->Pwm[BCM_REGS_PWM_CTL] &= ~(BCM_REGS_PWM_CTL_CHAN_MASK << ChanShift);
+   }
+   else
+   {
+      LedPwm->BcmRegs->Clk[BCM_REGS_CM_GP0CTL + LedPwm->Channel*BCM_REGS_CM_GP_STRIDE] =
+         BCM_REGS_CM_PASSWD | BCM_REGS_CM_SRC_OSC;
+   }
+
+   BCM_REGS_SetPinFunc(LedPwm->BcmRegs, LedPwm->Pin, BCM_REGS_FSEL_OUTPUT);
+
+   LedPwm->Active       = false;
+   LedPwm->FreqHz       = 0;
+   LedPwm->DutyPermille = 0;
+
+   CFE_EVS_SendEvent(LED_PWM_STOP_EID, CFE_EVS_EventType_INFORMATION,
+                     "GPIO pin %d PWM output stopped", LedPwm->Pin);
+
+} /* End LED_PWM_Stop() */
+
+
+/******************************************************************************
+** Function: LED_PWM_CheckRegsCmd
+**
+*/
+bool LED_PWM_CheckRegsCmd(void *DataObjPtr, const CFE_MSG_Message_t *MsgPtr)
+{
+
+   LED_PWM_Class_t *LedPwm = (LED_PWM_Class_t *)DataObjPtr;
+   const RPI_LED_PwmCheckRegs_CmdPayload_t *Cmd = CMDMGR_PAYLOAD_PTR(MsgPtr, RPI_LED_PwmCheckRegs_t);
+   LED_PWM_Class_t CheckPwm;
+   bool RetStatus;
+
+   if (LedPwm->Periph == LED_PWM_PERIPH_NONE)
+   {
+      CFE_EVS_SendEvent(LED_PWM_CHECK_REGS_EID, CFE_EVS_EventType_ERROR,
+                        "PWM register check rejected, GPIO pin %d has no PWM or GPCLK function", LedPwm->Pin);
+      return false;
+   }
+
+   if (!CheckRegs.Simulate)
+   {
+      BCM_REGS_Constructor(&CheckRegs, true, 0);
+      BCM_REGS_MapGpio(&CheckRegs);
+      BCM_REGS_MapPeriph(&CheckRegs);
+   }
+   memset(CheckRegs.SimGpio, 0, sizeof(CheckRegs.SimGpio));
+   memset(CheckRegs.SimClk,  0, sizeof(CheckRegs.SimClk));
+   memset(CheckRegs.SimPwm,  0, sizeof(CheckRegs.SimPwm));
+
+   CheckPwm = *LedPwm;
+   CheckPwm.BcmRegs = &CheckRegs;
+   CheckPwm.Active  = false;
+
+   if (CheckPwm.Periph == LED_PWM_PERIPH_PWM)
+   {
+      RetStatus = StartPwm(&CheckPwm, Cmd->FreqHz, Cmd->DutyPermille);
+   }
+   else
+   {
+      RetStatus = StartGpclk(&CheckPwm, Cmd->FreqHz, Cmd->DutyPermille);
+   }
+
+   if (RetStatus)
+   {
+      BCM_REGS_SetPinFunc(&CheckRegs, CheckPwm.Pin, CheckPwm.AltFunc);
+      if (CheckPwm.Periph == LED_PWM_PERIPH_PWM)
+      {
+         RetStatus = CheckPwmRegs(&CheckPwm, Cmd->FreqHz, Cmd->DutyPermille);
+      }
+      else
+      {
+         RetStatus = CheckGpclkRegs(&CheckPwm, Cmd->FreqHz);
+      }
+   }
+
+   return RetStatus;
+
+} /* End LED_PWM_CheckRegsCmd() */
+
+
+/******************************************************************************
+** Function: CheckGpclkRegs
+**
+** The 12.12 divisor must be the nearest to OscHz/FreqHz and MASH 1 must be
+** selected when it has a fractional part.
+*/
+static bool CheckGpclkRegs(LED_PWM_Class_t *LedPwm, uint32 FreqHz)
+{
+
+   volatile uint32 *Clk = LedPwm->BcmRegs->Clk;
+   uint32 Reg  = LedPwm->Channel * BCM_REGS_CM_GP_STRIDE;
+   uint32 Ctl  = Clk[BCM_REGS_CM_GP0CTL + Reg];
+   uint32 Div  = Clk[BCM_REGS_CM_GP0DIV + Reg];
+   uint32 Fsel = (LedPwm->BcmRegs->Gpio[BCM_REGS_GPFSEL0 + LedPwm->Pin/10] >> ((LedPwm->Pin%10)*3)) & 0x7;
+   uint32 Mash = ((Div & BCM_REGS_CM_DIVF_MASK) != 0) ? 1 : 0;
+   int64  Err  = (int64)(Div & BCM_REGS_CM_DIV_MASK) * FreqHz - ((int64)LedPwm->OscHz << 12);
+   bool   Passed;
+
+   Passed = ((Ctl & BCM_REGS_CM_PASSWD_MASK) == BCM_REGS_CM_PASSWD) &&
+            ((Div & BCM_REGS_CM_PASSWD_MASK) == BCM_REGS_CM_PASSWD) &&
+            ((Ctl & ~BCM_REGS_CM_PASSWD_MASK) ==
+             (BCM_REGS_CM_SRC_OSC | BCM_REGS_CM_ENAB | (Mash << BCM_REGS_CM_MASH_SHIFT))) &&
+            ((Div & BCM_REGS_CM_DIV_MASK) >= (2u << BCM_REGS_CM_DIVI_SHIFT)) &&
+            (2 * (Err < 0 ? -Err : Err) <= FreqHz) &&
+            (Fsel == LedPwm->AltFunc);
+
+   CFE_EVS_SendEvent(LED_PWM_CHECK_REGS_EID,
+                     Passed ? CFE_EVS_EventType_INFORMATION : CFE_EVS_EventType_ERROR,
+                     "PWM register check %s: GPIO pin %d GPCLK%d at %d Hz, CM_GP%dCTL 0x%08X, CM_GP%dDIV 0x%08X, FSEL %d",
+                     Passed ? "passed" : "FAILED", LedPwm->Pin, LedPwm->Channel, FreqHz,
+                     LedPwm->Channel, Ctl, LedPwm->Channel, Div, Fsel);
+
+   return Passed;
+
+} /* End CheckGpclkRegs() */
+
+
+/******************************************************************************
+** Function: CheckPwmRegs
+**
+** RNG must be the whole number of PWM clock ticks in the requested period
+** and DAT the whole number of those ticks in the duty cycle.
+*/
+static bool CheckPwmRegs(LED_PWM_Class_t *LedPwm, uint32 FreqHz, uint16 DutyPermille)
+{
+
+   volatile uint32 *Clk = LedPwm->BcmRegs->Clk;
+   volatile uint32 *Pwm = LedPwm->BcmRegs->Pwm;
+   uint32 ChanReg = LedPwm->Channel * BCM_REGS_PWM_CHAN_STRIDE;
+   uint32 Ctl     = Pwm[BCM_REGS_PWM_CTL];
+   uint32 Rng     = Pwm[BCM_REGS_PWM_RNG1 + ChanReg];
+   uint32 Dat     = Pwm[BCM_REGS_PWM_DAT1 + ChanReg];
+   uint32 ClkCtl  = Clk[BCM_REGS_CM_PWMCTL];
+   uint32 ClkDiv  = Clk[BCM_REGS_CM_PWMDIV];
+   uint32 Divi    = (ClkDiv & BCM_REGS_CM_DIV_MASK) >> BCM_REGS_CM_DIVI_SHIFT;
+   uint32 Fsel    = (LedPwm->BcmRegs->Gpio[BCM_REGS_GPFSEL0 + LedPwm->Pin/10] >> ((LedPwm->Pin%10)*3)) & 0x7;
+   uint64 TickHz  = (Divi > 0) ? LedPwm->OscHz / Divi : 0;
+   bool   Passed;
+
+   Passed = (ClkCtl == (BCM_REGS_CM_PASSWD | BCM_REGS_CM_SRC_OSC | BCM_REGS_CM_ENAB)) &&
+            ((ClkDiv & BCM_REGS_CM_PASSWD_MASK) == BCM_REGS_CM_PASSWD) &&
+            ((ClkDiv & BCM_REGS_CM_DIVF_MASK) == 0) &&
+            (((Ctl >> (LedPwm->Channel * BCM_REGS_PWM_CTL_CHAN_SHIFT)) & BCM_REGS_PWM_CTL_CHAN_MASK) ==
+             (BCM_REGS_PWM_CTL_PWEN | BCM_REGS_PWM_CTL_MSEN)) &&
+            (Rng > 0) && ((uint64)Rng * FreqHz <= TickHz) && ((uint64)(Rng + 1) * FreqHz > TickHz) &&
+            ((uint64)Dat * LED_PWM_MAX_DUTY <= (uint64)Rng * DutyPermille) &&
+            ((uint64)(Dat + 1) * LED_PWM_MAX_DUTY > (uint64)Rng * DutyPermille) &&
+            (Fsel == LedPwm->AltFunc);
+
+   CFE_EVS_SendEvent(LED_PWM_CHECK_REGS_EID,
+                     Passed ? CFE_EVS_EventType_INFORMATION : CFE_EVS_EventType_ERROR,
+                     "PWM register check %s: GPIO pin %d PWM%d at %d Hz %d.%d%%, CTL 0x%08X, RNG %d, DAT %d, CM_PWMCTL 0x%08X, CM_PWMDIV 0x%08X, FSEL %d",
+                     Passed ? "passed" : "FAILED", LedPwm->Pin, LedPwm->Channel, FreqHz,
+                     DutyPermille/10, DutyPermille%10, Ctl, Rng, Dat, ClkCtl, ClkDiv, Fsel);
+
+   return Passed;
+
+} /* End CheckPwmRegs() */
+
+
+/******************************************************************************
+** Function: SetClock
+**
+** Disable the clock, wait for it to stop, then load the divisor and enable.
+*/
+static bool SetClock(LED_PWM_Class_t *LedPwm, uint32 CtlReg, uint32 DivReg,
+                     uint32 Divisor, uint32 Mash)
+{
+
+   volatile uint32 *Clk = LedPwm->BcmRegs->Clk;
+   uint32 Ctl = BCM_REGS_CM_PASSWD | (Mash << BCM_REGS_CM_MASH_SHIFT) | BCM_REGS_CM_SRC_OSC;
+   uint16 Wait;
+
+   Clk[CtlReg] = BCM_REGS_CM_PASSWD | BCM_REGS_CM_SRC_OSC;
+   for (Wait=0; (Clk[CtlReg] & BCM_REGS_CM_BUSY) && Wait < LED_PWM_BUSY_WAIT_LIM; Wait++)
+   {
+      usleep(1);
+   }
+
+   if (Clk[CtlReg] & BCM_REGS_CM_BUSY)
+   {
+      CFE_EVS_SendEvent(LED_PWM_START_EID, CFE_EVS_EventType_ERROR,
+                        "PWM rejected, clock manager register 0x%02X remained busy after disable",
+                        CtlReg * 4);
+      return false;
+   }
+
+   Clk[DivReg] = BCM_REGS_CM_PASSWD | Divisor;
+   Clk[CtlReg] = Ctl;
+   Clk[CtlReg] = Ctl | BCM_REGS_CM_ENAB;
+
+   return true;
+
+} /* End SetClock() */
+
+
+/******************************************************************************
+** Function: StartGpclk
+**
+** The divisor is a 12.12 fixed point value. MASH 1 dithers the fractional
+** part which is only needed when it's non-zero.
+*/
+static bool StartGpclk(LED_PWM_Class_t *LedPwm, uint32 FreqHz, uint16 DutyPermille)
+{
+
+   uint64 Divisor;
+   uint32 Divi, Divf;
+   uint32 MinHz = LedPwm->OscHz / LED_PWM_GPCLK_MAX_DIVI + 1;
+   uint32 MaxHz = LedPwm->OscHz / 2;
+   uint32 Reg   = LedPwm->Channel * BCM_REGS_CM_GP_STRIDE;
+
+   if (DutyPermille != LED_PWM_GPCLK_DUTY)
+   {
+      CFE_EVS_SendEvent(LED_PWM_START_EID, CFE_EVS_EventType_ERROR,
+                        "PWM rejected, GPIO pin %d GPCLK output only supports 50.0%% duty", LedPwm->Pin);
+      return false;
+   }
+
+   if (FreqHz < MinHz || FreqHz > MaxHz)
+   {
+      CFE_EVS_SendEvent(LED_PWM_START_EID, CFE_EVS_EventType_ERROR,
+                        "PWM rejected, GPIO pin %d GPCLK frequency %d Hz not in range %d..%d",
+                        LedPwm->Pin, FreqHz, MinHz, MaxHz);
+      return false;
+   }
+
+   Divisor = (((uint64)LedPwm->OscHz << 12) + FreqHz/2) / FreqHz;
+   Divi    = (uint32)(Divisor >> 12);
+   Divf    = (uint32)(Divisor & BCM_REGS_CM_DIVF_MASK);
+
+   if (!SetClock(LedPwm, BCM_REGS_CM_GP0CTL + Reg, BCM_REGS_CM_GP0DIV + Reg,
+                 (Divi << BCM_REGS_CM_DIVI_SHIFT) | Divf, (Divf != 0) ? 1 : 0))
+   {
+      LED_PWM_Stop(LedPwm);  /* Clock is stopped so release the pin */
+      return false;
+   }
+
+   LedPwm->FreqHz = (uint32)(((uint64)LedPwm->OscHz << 12) / Divisor);
+
+   return true;
+
+} /* End StartGpclk() */
+
+
+/******************************************************************************
+** Function: StartPwm
+**
+** In mark/space mode the output is high for DAT of every RNG clock ticks.
+*/
+static bool StartPwm(LED_PWM_Class_t *LedPwm, uint32 FreqHz, uint16 DutyPermille)
+{
+
+   volatile uint32 *Pwm = LedPwm->BcmRegs->Pwm;
+   uint32 TickHz    = LedPwm->OscHz / LED_PWM_CLK_DIVI;
+   uint32 ChanShift = LedPwm->Channel * BCM_REGS_PWM_CTL_CHAN_SHIFT;
+   uint32 ChanReg   = LedPwm->Channel * BCM_REGS_PWM_CHAN_STRIDE;
+   uint32 Range;
+
+   if (FreqHz == 0 || FreqHz > TickHz/2 || DutyPermille > LED_PWM_MAX_DUTY)
+   {
+      CFE_EVS_SendEvent(LED_PWM_START_EID, CFE_EVS_EventType_ERROR,
+                        "PWM rejected, frequency %d Hz not in range 1..%d or duty %d above %d",
+                        FreqHz, TickHz/2, DutyPermille, LED_PWM_MAX_DUTY);
+      return false;
+   }
+
+   Range = TickHz / FreqHz;
+
+   Pwm[BCM_REGS_PWM_CTL] &= ~(BCM_REGS_PWM_CTL_CHAN_MASK << ChanShift);
+
+   if (!SetClock(LedPwm, BCM_REGS_CM_PWMCTL, BCM_REGS_CM_PWMDIV,
+                 LED_PWM_CLK_DIVI << BCM_REGS_CM_DIVI_SHIFT, 0))
+   {
+      LED_PWM_Stop(LedPwm);  /* Channel is disabled so release the pin */
+      return false;
+   }
+
+   Pwm[BCM_REGS_PWM_RNG1 + ChanReg] = Range;
+   Pwm[BCM_REGS_PWM_DAT1 + ChanReg] = (uint32)((uint64)Range * DutyPermille / LED_PWM_MAX_DUTY);
+   Pwm[BCM_REGS_PWM_CTL] = (Pwm[BCM_REGS_PWM_CTL] & ~(BCM_REGS_PWM_CTL_CHAN_MASK << ChanShift)) |
+                           ((BCM_REGS_PWM_CTL_PWEN | BCM_REGS_PWM_CTL_MSEN) << ChanShift);
+
+   LedPwm->FreqHz = TickHz / Range;
+
+   return true;
+
+} /* End StartPwm() */
@@ -0,0 +1,129 @@
+/*
+**  Copyright 2022 bitValence, Inc.
+**  All Rights Reserved.
+**
+**  This program is free software; you can modify and/or redistribute it
+**  under the terms of the GNU Affero General Public License
+**  as published by the Free Software Foundation; version 3 with
+**  attribution addendums as found in the LICENSE.txt
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Affero General Public License for more details.
+**
+**  Purpose:
+**    Define LED hardware PWM driver class
+**
+**  Notes:
+**    1. Dims or blinks the LED output pin using the BCM PWM peripheral, or
+**       a general purpose clock (GPCLK) for pins without a PWM function,
+**       so no CPU is used once the output is configured.
+**    2. The PWM runs in mark/space mode from the oscillator divided by
+**       LED_PWM_CLK_DIVI. A GPCLK output is a fixed 50% duty square wave
+**       whose frequency must be within oscillator/4095..oscillator/2.
+**    3. All register access is through BCM_REGS so the driver can be run
+**       against its simulated register file.
+**
+*/
+
+#ifndef _led_pwm_
+#define _led_pwm_
+
+/*
+** Includes
+*/
+#include "app_cfg.h"
+#include "bcm_regs.h"
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define LED_PWM_PERIPH_NONE   0
+#define LED_PWM_PERIPH_PWM    1
+#define LED_PWM_PERIPH_GPCLK  2
+
+#define LED_PWM_CLK_DIVI           2
+#define LED_PWM_MAX_DUTY        1000   /* Duty cycle is in tenths of a percent */
+#define LED_PWM_GPCLK_DUTY       500
+#define LED_PWM_GPCLK_MAX_DIVI  4095
+#define LED_PWM_BUSY_WAIT_LIM   1000   /* Clock BUSY polls before giving up */
+
+/*
+** Event Message IDs
+*/
+#define LED_PWM_CONSTRUCTOR_EID  (LED_PWM_BASE_EID + 0)
+#define LED_PWM_START_EID        (LED_PWM_BASE_EID + 1)
+#define LED_PWM_STOP_EID         (LED_PWM_BASE_EID + 2)
+#define LED_PWM_CHECK_REGS_EID   (LED_PWM_BASE_EID + 3)
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+/******************************************************************************
+** LED_PWM_Class
+*/
+typedef struct
+{
+   bool    Active;
+   uint8   Pin;
+   uint8   Periph;        /* LED_PWM_PERIPH_x routed to Pin */
+   uint8   Channel;       /* PWM channel or GPCLK number    */
+   uint8   AltFunc;
+   uint32  OscHz;
+
+   uint16  DutyPermille;
+   uint32  FreqHz;        /* Achieved frequency */
+
+   BCM_REGS_Class_t *BcmRegs;
+
+} LED_PWM_Class_t;
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+/******************************************************************************
+** Function: LED_PWM_Constructor
+**
+** Notes:
+**   1. A pin without a PWM or GPCLK function is not an error, Start() is
+**      rejected and the LED can only be switched on and off.
+*/
+void LED_PWM_Constructor(LED_PWM_Class_t *LedPwm, BCM_REGS_Class_t *BcmRegs,
+                         uint8 Pin, uint32 OscHz);
+
+/******************************************************************************
+** Function: LED_PWM_Start
+**
+** Program the peripheral and route it to the pin. Returns false and sends an
+** error event if the pin or the requested output is not supported. A
+** previous output keeps running after a rejected request but is stopped if
+** the peripheral fails after it has been disabled.
+*/
+bool LED_PWM_Start(LED_PWM_Class_t *LedPwm, uint32 FreqHz, uint16 DutyPermille);
+
+/******************************************************************************
+** Function: LED_PWM_Stop
+**
+** Disable the peripheral output and return the pin to a GPIO output. The
+** caller is responsible for driving the pin's level.
+*/
+void LED_PWM_Stop(LED_PWM_Class_t *LedPwm);
+
+/******************************************************************************
+** Function: LED_PWM_CheckRegsCmd
+**
+** Notes:
+**   1. Programs the requested output into an in-memory register file and
+**      decodes the clock manager, PWM and GPFSEL registers to verify the
+**      output frequency, duty cycle and pin routing. The result and the
+**      register values are reported in an event message.
+**   2. The hardware and the active output are not affected so the check
+**      can be run on any host.
+*/
+bool LED_PWM_CheckRegsCmd(void *DataObjPtr, const CFE_MSG_Message_t *MsgPtr);
+
+#endif /* _led_pwm_ */
@@ -0,0 +1,410 @@
+/*
+**  Copyright 2022 bitValence, Inc.
+**  All Rights Reserved.
+**
+**  This program is free software; you can modify and/or redistribute it
+**  under the terms of the GNU Affero General Public License
+**  as published by the Free Software Foundation; version 3 with
+**  attribution addendums as found in the LICENSE.txt
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Affero General Public License for more details.
+**
+**  Purpose:
+**    Implement the LED output readback (sense) class methods
+**
+**  Notes:
+**    1. Uses the GPIO character device v2 uAPI (Linux 5.10 or later). Edge
+**       event timestamps default to CLOCK_MONOTONIC which is also used for
+**       the command time so the two can be subtracted directly.
+**    2. Commands and the child task share state so all access is
+**       protected by the class mutex.
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+#include "app_cfg.h"
+#include "led_clock.h"
+#include "led_sense.h"
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+#define EDGE_BUF_LEN  16
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static void ReadLevel(LED_SENSE_Class_t *LedSense);
+static void SetEdgeDetect(LED_SENSE_Class_t *LedSense, bool Enable);
+
+
+/******************************************************************************
+** Function: LED_SENSE_Constructor
+**
+*/
+void LED_SENSE_Constructor(LED_SENSE_Class_t *LedSense, const char *ChipPath,
+                           uint8 SensePin, uint32 TimeoutMs)
+{
+
+   int  ChipFd;
+   struct gpio_v2_line_request Request;
+
+   memset(LedSense, 0, sizeof(LED_SENSE_Class_t));
+   LedSense->LineFd    = -1;
+   LedSense->SensePin  = SensePin;
+   LedSense->TimeoutMs = TimeoutMs;
+
+   if (SensePin == LED_SENSE_PIN_NONE)
+   {
+      return;
+   }
+
+   ChipFd = open(ChipPath, O_RDONLY | O_CLOEXEC);
+   if (ChipFd < 0)
+   {
+      CFE_EVS_SendEvent(LED_SENSE_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "Readback disabled. Open %s failed: %s", ChipPath, strerror(errno));
+      return;
+   }
+
+   memset(&Request, 0, sizeof(Request));
+   Request.offsets[0]   = SensePin;
+   Request.num_lines    = 1;
+   Request.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING |
+                          GPIO_V2_LINE_FLAG_EDGE_FALLING;
+   strncpy(Request.consumer, "rpi_led_sense", GPIO_MAX_NAME_SIZE-1);
+
+   if (ioctl(ChipFd, GPIO_V2_GET_LINE_IOCTL, &Request) < 0)
+   {
+      CFE_EVS_SendEvent(LED_SENSE_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "Readback disabled. Request for %s line %d failed: %s",
+                        ChipPath, SensePin, strerror(errno));
+      close(ChipFd);
+      return;
+   }
+   close(ChipFd);
+   LedSense->LineFd = Request.fd;
+
+   if (OS_MutSemCreate(&LedSense->MutexId, "RPI_LED_SENSE", 0) != OS_SUCCESS)
+   {
+      CFE_EVS_SendEvent(LED_SENSE_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "Readback disabled. Mutex creation failed");
+      close(LedSense->LineFd);
+      LedSense->LineFd = -1;
+      return;
+   }
+
+   ReadLevel(LedSense);
+
+   LedSense->Enabled = true;
+   CFE_EVS_SendEvent(LED_SENSE_CONSTRUCTOR_EID, CFE_EVS_EventType_INFORMATION,
+                     "Readback enabled on %s line %d, initially %s, %d ms timeout",
+                     ChipPath, SensePin, LedSense->SensedOn ? "ON" : "OFF", TimeoutMs);
+
+} /* End LED_SENSE_Constructor() */
+
+
+/******************************************************************************
+** Function: LED_SENSE_Expect
+**
+*/
+void LED_SENSE_Expect(LED_SENSE_Class_t *LedSense, bool LedOn)
+{
+
+   if (!LedSense->Enabled)
+   {
+      return;
+   }
+
+   OS_MutSemTake(LedSense->MutexId);
+
+   if (LedSense->Suspended)
+   {
+      /* No edges were reported while suspended so the level is stale */
+      SetEdgeDetect(LedSense, true);
+      ReadLevel(LedSense);
+      LedSense->Suspended = false;
+   }
+
+   LedSense->CmdLedOn  = LedOn;
+   LedSense->CmdTimeNs = LED_CLOCK_Ns(CLOCK_MONOTONIC);
+   if (LedSense->SensedOn == LedOn)
+   {
+      LedSense->CmdPending = false;
+      LedSense->Mismatch   = false;
+   }
+   else
+   {
+      LedSense->CmdPending = true;
+   }
+
+   OS_MutSemGive(LedSense->MutexId);
+
+} /* End LED_SENSE_Expect() */
+
+
+/******************************************************************************
+** Function: LED_SENSE_Suspend
+**
+*/
+void LED_SENSE_Suspend(LED_SENSE_Class_t *LedSense)
+{
+
+   if (!LedSense->Enabled)
+   {
+      return;
+   }
+
+   OS_MutSemTake(LedSense->MutexId);
+   if (!LedSense->Suspended)
+   {
+      SetEdgeDetect(LedSense, false);
+   }
+   LedSense->Suspended  = true;
+   LedSense->CmdPending = false;
+   LedSense->Mismatch   = false;
+   OS_MutSemGive(LedSense->MutexId);
+
+} /* End LED_SENSE_Suspend() */
+
+
+/******************************************************************************
+** Function: LED_SENSE_ResetStatus
+**
+*/
+void LED_SENSE_ResetStatus(LED_SENSE_Class_t *LedSense)
+{
+
+   if (!LedSense->Enabled)
+   {
+      return;
+   }
+
+   OS_MutSemTake(LedSense->MutexId);
+   LedSense->MismatchCnt  = 0;
+   LedSense->EdgeCnt      = 0;
+   LedSense->LatencyMaxUs = 0;
+   OS_MutSemGive(LedSense->MutexId);
+
+} /* End LED_SENSE_ResetStatus() */
+
+
+/******************************************************************************
+** Function: LED_SENSE_CheckTimeout
+**
+*/
+void LED_SENSE_CheckTimeout(LED_SENSE_Class_t *LedSense, uint64 NowNs)
+{
+
+   bool TimedOut = false;
+   bool CmdLedOn;
+
+   if (!LedSense->Enabled)
+   {
+      return;
+   }
+
+   OS_MutSemTake(LedSense->MutexId);
+
+   if (LedSense->CmdPending &&
+       (NowNs - LedSense->CmdTimeNs) >= (uint64)LedSense->TimeoutMs * 1000000)
+   {
+      LedSense->CmdPending = false;
+      LedSense->Mismatch   = true;
+      LedSense->MismatchCnt++;
+      TimedOut = true;
+   }
+   CmdLedOn = LedSense->CmdLedOn;
+
+   OS_MutSemGive(LedSense->MutexId);
+
+   if (TimedOut)
+   {
+      CFE_EVS_SendEvent(LED_SENSE_MISMATCH_EID, CFE_EVS_EventType_ERROR,
+                        "Sense pin %d did not follow output commanded %s within %d ms",
+                        LedSense->SensePin, CmdLedOn ? "ON" : "OFF", LedSense->TimeoutMs);
+   }
+
+} /* End LED_SENSE_CheckTimeout() */
+
+
+/******************************************************************************
+** Function: LED_SENSE_Deadline
+**
+*/
+uint64 LED_SENSE_Deadline(LED_SENSE_Class_t *LedSense)
+{
+
+   uint64 DeadlineNs = 0;
+
+   if (!LedSense->Enabled)
+   {
+      return 0;
+   }
+
+   OS_MutSemTake(LedSense->MutexId);
+   if (LedSense->CmdPending)
+   {
+      DeadlineNs = LedSense->CmdTimeNs + (uint64)LedSense->TimeoutMs * 1000000;
+   }
+   OS_MutSemGive(LedSense->MutexId);
+
+   return DeadlineNs;
+
+} /* End LED_SENSE_Deadline() */
+
+
+/******************************************************************************
+** Function: LED_SENSE_ProcessEdges
+**
+** Compare the sensed state with the commanded state for each queued edge.
+** An edge that confirms a pending command records the latency. An edge
+** away from the commanded state while nothing is pending indicates a stuck,
+** shorted or externally driven line. Edges that occurred before the last
+** command was issued were queued while the command was processed, they
+** can neither confirm nor contradict it.
+*/
+bool LED_SENSE_ProcessEdges(LED_SENSE_Class_t *LedSense)
+{
+
+   struct gpio_v2_line_event Edges[EDGE_BUF_LEN];
+   ssize_t BytesRead;
+   int     EdgeCnt, i;
+   uint64  LatencyUs;
+   bool    Unexpected = false;
+   bool    SensedOn   = false;
+
+   BytesRead = read(LedSense->LineFd, Edges, sizeof(Edges));
+   if (BytesRead < 0)
+   {
+      if (errno == EAGAIN || errno == EINTR)
+      {
+         return true;
+      }
+      CFE_EVS_SendEvent(LED_SENSE_EDGE_EID, CFE_EVS_EventType_ERROR,
+                        "Readback edge read failed, monitoring stopped: %s", strerror(errno));
+      LedSense->Enabled = false;
+      return false;
+   }
+   EdgeCnt = BytesRead / sizeof(struct gpio_v2_line_event);
+
+   OS_MutSemTake(LedSense->MutexId);
+
+   for (i=0; i < EdgeCnt; i++)
+   {
+      LedSense->SensedOn = (Edges[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE);
+      LedSense->EdgeCnt++;
+
+      if (LedSense->Suspended)
+      {
+         continue;
+      }
+
+      if (Edges[i].timestamp_ns < LedSense->CmdTimeNs)
+      {
+         /* Queued before the last command so it only updates the known level */
+         LedSense->CmdPending = (LedSense->SensedOn != LedSense->CmdLedOn);
+      }
+      else if (LedSense->CmdPending)
+      {
+         if (LedSense->SensedOn == LedSense->CmdLedOn)
+         {
+            LatencyUs = (Edges[i].timestamp_ns - LedSense->CmdTimeNs) / 1000;
+            LedSense->LatencyUs = (LatencyUs > UINT32_MAX) ? UINT32_MAX : (uint32)LatencyUs;
+            if (LedSense->LatencyUs > LedSense->LatencyMaxUs)
+            {
+               LedSense->LatencyMaxUs = LedSense->LatencyUs;
+            }
+            LedSense->CmdPending = false;
+            LedSense->Mismatch   = false;
+         }
+      }
+      else if (LedSense->SensedOn != LedSense->CmdLedOn)
+      {
+         LedSense->Mismatch = true;
+         LedSense->MismatchCnt++;
+         Unexpected = true;
+         SensedOn   = LedSense->SensedOn;
+      }
+      else
+      {
+         LedSense->Mismatch = false;
+      }
+   }
+
+   OS_MutSemGive(LedSense->MutexId);
+
+   if (Unexpected)
+   {
+      CFE_EVS_SendEvent(LED_SENSE_MISMATCH_EID, CFE_EVS_EventType_ERROR,
+                        "Sense pin %d changed to %s without a command",
+                        LedSense->SensePin, SensedOn ? "ON" : "OFF");
+   }
+
+   return true;
+
+} /* End LED_SENSE_ProcessEdges() */
+
+
+/******************************************************************************
+** Function: ReadLevel
+**
+*/
+static void ReadLevel(LED_SENSE_Class_t *LedSense)
+{
+
+   struct gpio_v2_line_values Values;
+
+   memset(&Values, 0, sizeof(Values));
+   Values.mask = 1;
+   if (ioctl(LedSense->LineFd, GPIO_V2_LINE_GET_VALUES_IOCTL, &Values) == 0)
+   {
+      LedSense->SensedOn = ((Values.bits & 1) != 0);
+   }
+
+} /* End ReadLevel() */
+
+
+/******************************************************************************
+** Function: SetEdgeDetect
+**
+** Disabling edge detection stops the kernel queuing an event for every
+** transition, e.g. while the output is driven by PWM, so the child task
+** isn't woken. A failure is reported but isn't fatal, queued edges are
+** ignored while suspended.
+*/
+static void SetEdgeDetect(LED_SENSE_Class_t *LedSense, bool Enable)
+{
+
+   struct gpio_v2_line_config Config;
+
+   memset(&Config, 0, sizeof(Config));
+   Config.flags = GPIO_V2_LINE_FLAG_INPUT;
+   if (Enable)
+   {
+      Config.flags |= GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+   }
+
+   if (ioctl(LedSense->LineFd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &Config) < 0)
+   {
+      CFE_EVS_SendEvent(LED_SENSE_EDGE_EID, CFE_EVS_EventType_ERROR,
+                        "Readback edge detection %s failed: %s",
+                        Enable ? "enable" : "disable", strerror(errno));
+   }
+
+} /* End SetEdgeDetect() */
@@ -0,0 +1,142 @@
+/*
+**  Copyright 2022 bitValence, Inc.
+**  All Rights Reserved.
+**
+**  This program is free software; you can modify and/or redistribute it
+**  under the terms of the GNU Affero General Public License
+**  as published by the Free Software Foundation; version 3 with
+**  attribution addendums as found in the LICENSE.txt
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Affero General Public License for more details.
+**
+**  Purpose:
+**    Define LED output readback (sense) class
+**
+**  Notes:
+**    1. A sense input is an optional GPIO input wired to the LED output
+**       line. It is monitored using edge events from the Linux GPIO
+**       character device so no CPU is used while the line is idle. The
+**       owner polls LineFd and calls ProcessEdges() when it's readable and
+**       CheckTimeout() at the time returned by Deadline().
+**    2. Any gpiochip can be used, including one created by the kernel's
+**       gpio-sim module, so readback can be exercised without hardware.
+**
+*/
+
+#ifndef _led_sense_
+#define _led_sense_
+
+/*
+** Includes
+*/
+#include "app_cfg.h"
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define LED_SENSE_PIN_NONE  255  /* CTRL_SENSE_PIN value that disables readback */
+
+/*
+** Event Message IDs
+*/
+#define LED_SENSE_CONSTRUCTOR_EID  (LED_SENSE_BASE_EID + 0)
+#define LED_SENSE_MISMATCH_EID     (LED_SENSE_BASE_EID + 1)
+#define LED_SENSE_EDGE_EID         (LED_SENSE_BASE_EID + 2)
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+/******************************************************************************
+** LED_SENSE_Class
+**
+** - The command fields are written by the main task and the sensed fields
+**   by the child task so all access is protected by MutexId
+*/
+typedef struct
+{
+   bool    Enabled;
+   bool    Suspended;      /* Output is not at a steady commanded level */
+   uint8   SensePin;
+   uint32  TimeoutMs;      /* Time allowed for the sense line to follow a command */
+
+   bool    CmdLedOn;       /* Last commanded state                              */
+   bool    CmdPending;     /* Commanded state not yet confirmed by sense line   */
+   uint64  CmdTimeNs;      /* CLOCK_MONOTONIC time of the last on/off cmd       */
+
+   bool    SensedOn;
+   bool    Mismatch;       /* Latched until the sense line matches the command  */
+   uint16  MismatchCnt;
+   uint16  EdgeCnt;
+   uint32  LatencyUs;      /* Last command-to-sense latency */
+   uint32  LatencyMaxUs;
+
+   int     LineFd;
+   osal_id_t MutexId;
+
+} LED_SENSE_Class_t;
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+/******************************************************************************
+** Function: LED_SENSE_Constructor
+**
+** Notes:
+**   1. A SensePin of LED_SENSE_PIN_NONE disables readback and is not an error.
+*/
+void LED_SENSE_Constructor(LED_SENSE_Class_t *LedSense, const char *ChipPath,
+                           uint8 SensePin, uint32 TimeoutMs);
+
+/******************************************************************************
+** Function: LED_SENSE_Expect
+**
+** Notes:
+**   1. Must be called before the output is written so the command time
+**      precedes the sense edge.
+*/
+void LED_SENSE_Expect(LED_SENSE_Class_t *LedSense, bool LedOn);
+
+/******************************************************************************
+** Function: LED_SENSE_Suspend
+**
+** Stop comparing the sensed and commanded states, e.g. while the output is
+** driven by a PWM peripheral. Edge detection is disabled so the line doesn't
+** generate events. The next LED_SENSE_Expect() call resumes.
+*/
+void LED_SENSE_Suspend(LED_SENSE_Class_t *LedSense);
+
+/******************************************************************************
+** Function: LED_SENSE_CheckTimeout
+**
+** Flag a mismatch if the sense line did not follow a command in time.
+*/
+void LED_SENSE_CheckTimeout(LED_SENSE_Class_t *LedSense, uint64 NowNs);
+
+/******************************************************************************
+** Function: LED_SENSE_Deadline
+**
+** Return the CLOCK_MONOTONIC time a pending command times out or 0 if no
+** command is pending.
+*/
+uint64 LED_SENSE_Deadline(LED_SENSE_Class_t *LedSense);
+
+/******************************************************************************
+** Function: LED_SENSE_ProcessEdges
+**
+** Read queued edge events. Returns false and disables readback if the line
+** can't be read.
+*/
+bool LED_SENSE_ProcessEdges(LED_SENSE_Class_t *LedSense);
+
+/******************************************************************************
+** Function: LED_SENSE_ResetStatus
+*/
+void LED_SENSE_ResetStatus(LED_SENSE_Class_t *LedSense);
+
+#endif /* _led_sense_ */
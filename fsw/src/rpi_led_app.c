@@ -25,13 +25,16 @@
 */
 
 #include <string.h>
+#include "led_clock.h"
 #include "rpi_led_app.h"
 #include "rpi_led_eds_cc.h"
 
-#define  INITBL_OBJ    (&(RpiLed.IniTbl))
-#define  CMDMGR_OBJ    (&(RpiLed.CmdMgr))
-#define  CHILDMGR_OBJ  (&(RpiLed.ChildMgr))
-#define  LED_CTRL_OBJ  (&(RpiLed.LedCtrl))
+#define  INITBL_OBJ      (&(RpiLed.IniTbl))
+#define  CMDMGR_OBJ      (&(RpiLed.CmdMgr))
+#define  CHILDMGR_OBJ    (&(RpiLed.ChildMgr))
+#define  LED_CTRL_OBJ    (&(RpiLed.LedCtrl))
+#define  LED_MATRIX_OBJ  (&(RpiLed.LedCtrl.Matrix))
+#define  LED_PWM_OBJ     (&(RpiLed.LedCtrl.Pwm))
 
 static int32 InitApp(void);
 static int32 ProcessCommands(void);
@@ -49,7 +52,8 @@ DEFINE_ENUM(Config, APP_CONFIG)
 
 static CFE_EVS_BinFilter_t  EventFilters[] =
 {  
-   {LED_CTRL_CHILD_TASK_EID,   CFE_EVS_FIRST_4_STOP}
+   {LED_CTRL_CHILD_TASK_EID,   CFE_EVS_FIRST_4_STOP},
+   {LED_SENSE_MISMATCH_EID,    CFE_EVS_FIRST_4_STOP}
 };
 
 RPI_LED_Class_t  RpiLed;
@@ -87,6 +91,7 @@ bool RPI_LED_NoOpCmd(void *ObjDataPtr, const CFE_MSG_Message_t *MsgPtr)
 bool RPI_LED_ResetAppCmd(void *ObjDataPtr, const CFE_MSG_Message_t *MsgPtr)
 {
    CFE_EVS_ResetAllFilters();
+   RpiLed.WakeupCnt = 0;
    CMDMGR_ResetStatus(CMDMGR_OBJ);
    CHILDMGR_ResetStatus(CHILDMGR_OBJ);
    LED_CTRL_ResetStatus();
@@ -116,6 +121,9 @@ static int32 InitApp(void)
 
       CFE_ES_PerfLogEntry(RpiLed.PerfId);
 
+      /* Child task uses LedCtrl so it must be constructed first */
+      LED_CTRL_Constructor(LED_CTRL_OBJ, &RpiLed.IniTbl);
+
       /* Constructor sends error events */  
       ChildTaskInit.TaskName  = INITBL_GetStrConfig(INITBL_OBJ, CFG_CHILD_NAME);
       ChildTaskInit.PerfId    = INITBL_GetIntConfig(INITBL_OBJ, CFG_CHILD_PERF_ID);
@@ -127,8 +135,6 @@ static int32 InitApp(void)
   
    if (Status == CFE_SUCCESS)
    {
-      LED_CTRL_Constructor(LED_CTRL_OBJ, &RpiLed.IniTbl);
-
       /*
       ** Initialize app level interfaces
       */
@@ -144,6 +150,13 @@ static int32 InitApp(void)
       
       CMDMGR_RegisterFunc(CMDMGR_OBJ, RPI_LED_TURN_ON_CC, LED_CTRL_OBJ, LED_CTRL_TurnOnCmd, 0);
       CMDMGR_RegisterFunc(CMDMGR_OBJ, RPI_LED_TURN_OFF_CC, LED_CTRL_OBJ, LED_CTRL_TurnOffCmd, 0);
+      CMDMGR_RegisterFunc(CMDMGR_OBJ, RPI_LED_SET_PWM_CC,  LED_CTRL_OBJ, LED_CTRL_SetPwmCmd,  sizeof(RPI_LED_SetPwm_CmdPayload_t));
+      CMDMGR_RegisterFunc(CMDMGR_OBJ, RPI_LED_STOP_PWM_CC, LED_CTRL_OBJ, LED_CTRL_StopPwmCmd, 0);
+      CMDMGR_RegisterFunc(CMDMGR_OBJ, RPI_LED_PWM_CHECK_REGS_CC, LED_PWM_OBJ, LED_PWM_CheckRegsCmd, sizeof(RPI_LED_PwmCheckRegs_CmdPayload_t));
+
+      CMDMGR_RegisterFunc(CMDMGR_OBJ, RPI_LED_MATRIX_SET_FRAME_CC,     LED_MATRIX_OBJ, LED_MATRIX_SetFrameCmd,     sizeof(RPI_LED_MatrixSetFrame_CmdPayload_t));
+      CMDMGR_RegisterFunc(CMDMGR_OBJ, RPI_LED_MATRIX_SET_REGION_CC,    LED_MATRIX_OBJ, LED_MATRIX_SetRegionCmd,    sizeof(RPI_LED_MatrixSetRegion_CmdPayload_t));
+      CMDMGR_RegisterFunc(CMDMGR_OBJ, RPI_LED_MATRIX_RUN_BENCHMARK_CC, LED_MATRIX_OBJ, LED_MATRIX_RunBenchmarkCmd, sizeof(RPI_LED_MatrixRunBenchmark_CmdPayload_t));
 
       CFE_MSG_Init(CFE_MSG_PTR(RpiLed.StatusTlm.TelemetryHeader), CFE_SB_ValueToMsgId(INITBL_GetIntConfig(INITBL_OBJ, CFG_RPI_LED_STATUS_TLM_TOPICID)), sizeof(RPI_LED_StatusTlm_t));
    
@@ -176,6 +189,7 @@ static int32 ProcessCommands(void)
    CFE_ES_PerfLogExit(RpiLed.PerfId);
    SysStatus = CFE_SB_ReceiveBuffer(&SbBufPtr, RpiLed.CmdPipe, CFE_SB_PEND_FOREVER);
    CFE_ES_PerfLogEntry(RpiLed.PerfId);
+   RpiLed.WakeupCnt++;
 
    if (SysStatus == CFE_SUCCESS)
    {
@@ -242,6 +256,35 @@ static void SendStatusTlm(void)
    StatusTlmPayload->CtrlLedOn     = RpiLed.LedCtrl.LedOn;
    StatusTlmPayload->CtrlSpare     = 0;
 
+   StatusTlmPayload->SenseEnabled      = RpiLed.LedCtrl.Sense.Enabled;
+   StatusTlmPayload->SensePin          = RpiLed.LedCtrl.Sense.SensePin;
+   StatusTlmPayload->SenseLedOn        = RpiLed.LedCtrl.Sense.SensedOn;
+   StatusTlmPayload->SenseMismatch     = RpiLed.LedCtrl.Sense.Mismatch;
+   StatusTlmPayload->SenseMismatchCnt  = RpiLed.LedCtrl.Sense.MismatchCnt;
+   StatusTlmPayload->SenseEdgeCnt      = RpiLed.LedCtrl.Sense.EdgeCnt;
+   StatusTlmPayload->SenseLatencyUs    = RpiLed.LedCtrl.Sense.LatencyUs;
+   StatusTlmPayload->SenseLatencyMaxUs = RpiLed.LedCtrl.Sense.LatencyMaxUs;
+
+   StatusTlmPayload->MatrixEnabled        = RpiLed.LedCtrl.Matrix.Enabled;
+   StatusTlmPayload->MatrixRows           = RpiLed.LedCtrl.Matrix.Rows;
+   StatusTlmPayload->MatrixCols           = RpiLed.LedCtrl.Matrix.Cols;
+   StatusTlmPayload->MatrixSpare          = 0;
+   StatusTlmPayload->MatrixFrameCnt       = RpiLed.LedCtrl.Matrix.FrameCnt;
+   StatusTlmPayload->MatrixRefreshMilliHz = RpiLed.LedCtrl.Matrix.RefreshMilliHz;
+   StatusTlmPayload->MatrixJitterAvgUs    = RpiLed.LedCtrl.Matrix.JitterAvgUs;
+   StatusTlmPayload->MatrixJitterMaxUs    = RpiLed.LedCtrl.Matrix.JitterMaxUs;
+
+   StatusTlmPayload->PwmActive       = RpiLed.LedCtrl.Pwm.Active;
+   StatusTlmPayload->PwmPeriph       = RpiLed.LedCtrl.Pwm.Periph;
+   StatusTlmPayload->PwmDutyPermille = RpiLed.LedCtrl.Pwm.DutyPermille;
+   StatusTlmPayload->PwmFreqHz       = RpiLed.LedCtrl.Pwm.FreqHz;
+
+   /* Status is sent from the main task so this is the main task's CPU time */
+   StatusTlmPayload->MainWakeupCnt  = RpiLed.WakeupCnt;
+   StatusTlmPayload->MainCpuTimeMs  = (uint32)(LED_CLOCK_Ns(CLOCK_THREAD_CPUTIME_ID) / LED_CLOCK_NSEC_PER_MSEC);
+   StatusTlmPayload->ChildWakeupCnt = RpiLed.LedCtrl.ChildWakeupCnt;
+   StatusTlmPayload->ChildCpuTimeMs = RpiLed.LedCtrl.ChildCpuTimeMs;
+
    CFE_SB_TimeStampMsg(CFE_MSG_PTR(RpiLed.StatusTlm.TelemetryHeader));
    CFE_SB_TransmitMsg(CFE_MSG_PTR(RpiLed.StatusTlm.TelemetryHeader), true);
 }
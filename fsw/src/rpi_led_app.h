@@ -69,6 +69,7 @@ typedef struct
    CFE_SB_PipeId_t    CmdPipe;
    CFE_SB_MsgId_t     CmdMid;
    CFE_SB_MsgId_t     SendStatusMid;
+   uint32             WakeupCnt;
    
    LED_CTRL_Class_t   LedCtrl;
  